@@ -10,7 +10,7 @@
 # License: Unlicensed
 
 CXX=g++
-CXXFLAGS=-g -O0 -std=c++11 -fdiagnostics-color=auto
+CXXFLAGS=-g -O0 -std=c++11 -pthread -fdiagnostics-color=auto
 
 AR=ar
 ARFLAGS=rcs
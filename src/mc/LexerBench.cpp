@@ -0,0 +1,130 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/* Compares the dynamic Lexer configured with the Mitten grammar against
+ * MittenLexer, checking that both produce the same tokens. Lexes the files
+ * given as arguments, or a generated source if there are none. Set the
+ * optimization level in config.mk before comparing numbers. */
+
+#include <iostream>
+#include <chrono>
+#include <MPTK.h>
+
+#include "language/MittenLexer.h"
+
+using namespace std;
+using namespace mitten;
+
+string generateSource(size_t lines)
+{
+	string rtn = "/* generated\n * source\n */\ninclude(std);\n\n";
+	for (size_t i = 0; i < lines; i++)
+	{
+		rtn += "var x" + to_string(i) + " = (a" + to_string(i%7) + " << 2) + 0x1F * \"str" + to_string(i) + "\"; // note\n";
+		if (i%10 == 0)
+			rtn += "if (x" + to_string(i) + " >= 10 && y != 'c') { z[" + to_string(i) + "] ^= 3.5e2; }\n";
+	}
+	return rtn;
+}
+
+template <typename L> double timeLexer(L &lexer, shared_ptr<const SourceBuffer> b, int runs, vector<Token> &toks)
+{
+	InternalErrorHandler eh;
+	auto start = chrono::steady_clock::now();
+	for (int i = 0; i < runs; i++)
+		toks = lexer.lex(b, eh);
+	return chrono::duration<double, milli>(chrono::steady_clock::now()-start).count()/runs;
+}
+
+template <typename L> struct CachedLexer
+{
+	TokenCache &cache;
+	L &lexer;
+
+	CachedLexer(TokenCache &c, L &l) : cache(c), lexer(l) {}
+
+	vector<Token> lex(shared_ptr<const SourceBuffer> b, ErrorHandler &eh)
+	{
+		return cache.lex(lexer, b, eh);
+	}
+};
+
+int main(int argc, char *argv[])
+{
+	vector<shared_ptr<const SourceBuffer> > inputs;
+	for (int i = 1; i < argc; i++)
+		inputs.push_back(SourceBuffer::fromFile(argv[i]));
+	if (inputs.empty())
+		inputs.push_back(SourceBuffer::fromString(generateSource(100000), "generated"));
+
+	Lexer dynamicLexer;
+	MittenLexer::deliminate(dynamicLexer);
+	MittenLexer staticLexer;
+	TokenCache cache("LexerBench.cache");
+	CachedLexer<MittenLexer> cachedLexer(cache, staticLexer);
+
+	int rtn = 0;
+	for (auto &i : inputs)
+	{
+		vector<Token> dtoks, stoks;
+		double d = timeLexer(dynamicLexer, i, 5, dtoks);
+		double s = timeLexer(staticLexer, i, 5, stoks);
+		InternalErrorHandler eh;
+		cachedLexer.lex(i, eh);
+		vector<Token> ctoks;
+		double c = timeLexer(cachedLexer, i, 5, ctoks);
+
+		bool same = (dtoks.size() == stoks.size());
+		for (size_t j = 0; same && j < dtoks.size(); j++)
+			same = (dtoks[j].offset() == stoks[j].offset() && dtoks[j].length() == stoks[j].length() && dtoks[j].tag() == stoks[j].tag() && dtoks[j].filtered() == stoks[j].filtered());
+		same = same && (ctoks.size() == stoks.size());
+		for (size_t j = 0; same && j < stoks.size(); j++)
+			same = (ctoks[j].offset() == stoks[j].offset() && ctoks[j].length() == stoks[j].length() && ctoks[j].tag() == stoks[j].tag() && ctoks[j].filtered() == stoks[j].filtered());
+
+		cout << i->path() << ": " << i->size() << " bytes, " << dtoks.size() << " tokens\n";
+		cout << "  Lexer:       " << d << " ms\n";
+		cout << "  MittenLexer: " << s << " ms (" << (s > 0 ? d/s : 0) << "x)\n";
+		cout << "  TokenCache:  " << c << " ms (" << (c > 0 ? d/c : 0) << "x)\n";
+		if (!same)
+		{
+			cout << "  token mismatch!\n";
+			rtn = 1;
+		}
+	}
+
+	return rtn;
+}
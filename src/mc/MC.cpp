@@ -53,6 +53,7 @@ int main(int argc, char *argv[])
 	clp.copyright = "Copyright 2014 Oliver Katz";
 
 	clp["I"].setDescription("Adds its argument to the include path.").setType("path").addExample("-I.").addExample("-I/opt/usr/include").addValue("/usr/include").requestArgument();
+	clp["cache"].setDescription("Caches lexed tokens in the directory given, to be reused while sources are unchanged.").setType("path").addExample("-cache .mc-cache").requestArgument().requestUseNextArgument();
 	clp["o"].setDescription("Sets the output file path.").setType("path").addExample("-o a.out").requestArgument().requestUseNextArgument();
 
 	if (clp.parse(argc, argv))
@@ -66,9 +67,14 @@ int main(int argc, char *argv[])
 		return 2;
 	}
 
+	unique_ptr<TokenCache> cache;
+	if (!clp["cache"].values.empty())
+		cache.reset(new TokenCache(clp["cache"].values.back()));
+
 	for (auto i : clp.freeArguments)
 	{
 		MittenSource source = MittenSource::fromFile(i);
+		source.setTokenCache(cache.get());
 
 		if (source.compile())
 		{
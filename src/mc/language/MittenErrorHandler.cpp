@@ -48,9 +48,12 @@ namespace mitten
 		errorPage += to_string(source.line())+":"+to_string(source.column())+" - "+message+"\n";
 		errorPage += "    from '"+source.value()+"'\n";
 
-		if (!fileBody.empty())
+		SourceTable &table = SourceTable::global();
+		StringRef text;
+		if ((!source.owned() && table.lineText(source.fileId(), source.line(), text)) || 
+			(hasFileBody && table.lineText(fileBody, source.line(), text)))
 		{
-			errorPage += fileBody[source.line()-1]+"\n";
+			errorPage += text.str()+"\n";
 			errorPage += string(source.column(), ' ')+"^\n";
 		}
 
@@ -65,14 +68,8 @@ namespace mitten
 
 	void MittenErrorHandler::setFileBody(string b)
 	{
-		istringstream ss(b);
-
-		while (!ss.eof())
-		{
-			string tmp;
-			getline(ss, tmp);
-			fileBody.push_back(tmp);
-		}
+		fileBody = SourceTable::global().add(SourceBuffer::fromString(b, filePath));
+		hasFileBody = true;
 	}
 
 	void MittenErrorHandler::mismatchedStructureBounds(Token source, std::string start, std::string end)
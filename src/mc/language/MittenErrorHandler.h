@@ -48,7 +48,8 @@ namespace mitten
 	{
 	protected:
 		std::string filePath;
-		std::vector<std::string> fileBody;
+		SourceTable::FileId fileBody;
+		bool hasFileBody;
 
 		std::string errorPage;
 		int errorCount;
@@ -56,7 +57,7 @@ namespace mitten
 		void append(Token source, std::string message);
 
 	public:
-		MittenErrorHandler() : errorCount(0) {}
+		MittenErrorHandler() : fileBody(0), hasFileBody(false), errorCount(0) {}
 
 		void setFilePath(std::string f);
 		void setFileBody(std::string b);
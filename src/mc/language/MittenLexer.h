@@ -0,0 +1,116 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_LEXER_GRAMMAR_H
+#define __MITTEN_LEXER_GRAMMAR_H
+
+#include <iostream>
+#include <MPTK.h>
+
+namespace mitten
+{
+	/*! \brief The lexical grammar of Mitten, fixed at compile time.
+	 */
+	typedef StaticLexer<
+		StaticDeliminator<Chars<' '>, Chars<>, Filtered>,
+		StaticDeliminator<Chars<'\t'>, Chars<>, Filtered>,
+		StaticDeliminator<Chars<'\n'>, Chars<>, Filtered>,
+		StaticDeliminator<Chars<'('> >,
+		StaticDeliminator<Chars<')'> >,
+		StaticDeliminator<Chars<','> >,
+		StaticDeliminator<Chars<'{'> >,
+		StaticDeliminator<Chars<'}'> >,
+		StaticDeliminator<Chars<';'> >,
+		StaticDeliminator<Chars<'['> >,
+		StaticDeliminator<Chars<']'> >,
+		StaticDeliminator<Chars<'"'>, Chars<'"'> >,
+		StaticDeliminator<Chars<'\''>, Chars<'\''> >,
+		StaticDeliminator<Chars<'"', '"', '"'>, Chars<'"', '"', '"'> >,
+		StaticDeliminator<Chars<'/', '/'>, Chars<'\n'>, Filtered>,
+		StaticDeliminator<Chars<'/', '*'>, Chars<'*', '/'>, Filtered>,
+		StaticDeliminator<Chars<'+'> >,
+		StaticDeliminator<Chars<'-'> >,
+		StaticDeliminator<Chars<'*'> >,
+		StaticDeliminator<Chars<'/'> >,
+		StaticDeliminator<Chars<'%'> >,
+		StaticDeliminator<Chars<'&'> >,
+		StaticDeliminator<Chars<'|'> >,
+		StaticDeliminator<Chars<'^'> >,
+		StaticDeliminator<Chars<'<', '<'> >,
+		StaticDeliminator<Chars<'>', '>'> >,
+		StaticDeliminator<Chars<'~'> >,
+		StaticDeliminator<Chars<'&', '&'> >,
+		StaticDeliminator<Chars<'|', '|'> >,
+		StaticDeliminator<Chars<'^', '^'> >,
+		StaticDeliminator<Chars<'!'> >,
+		StaticDeliminator<Chars<'='> >,
+		StaticDeliminator<Chars<'+', '='> >,
+		StaticDeliminator<Chars<'-', '='> >,
+		StaticDeliminator<Chars<'*', '='> >,
+		StaticDeliminator<Chars<'/', '='> >,
+		StaticDeliminator<Chars<'%', '='> >,
+		StaticDeliminator<Chars<'&', '='> >,
+		StaticDeliminator<Chars<'|', '='> >,
+		StaticDeliminator<Chars<'^', '='> >,
+		StaticDeliminator<Chars<'<', '<', '='> >,
+		StaticDeliminator<Chars<'>', '>', '='> >,
+		StaticDeliminator<Chars<'~', '='> >,
+		StaticDeliminator<Chars<'=', '='> >,
+		StaticDeliminator<Chars<'!', '='> >,
+		StaticDeliminator<Chars<'<'> >,
+		StaticDeliminator<Chars<'<', '='> >,
+		StaticDeliminator<Chars<'>'> >,
+		StaticDeliminator<Chars<'>', '='> >,
+		StaticDeliminator<Chars<':'> > > MittenLexer;
+
+	/*! \brief The keyword ids of Mitten.
+	 * Ids follow the order of MittenKeywords.
+	 */
+	typedef enum
+	{
+		IncludeKeyword = 1 //! 'include'
+	} MittenKeyword;
+
+	/*! \brief Gets the keywords of Mitten, to give to a MittenLexer.
+	 */
+	inline KeywordTable MittenKeywords()
+	{
+		return KeywordTable({"include"});
+	}
+}
+
+#endif
@@ -40,59 +40,9 @@ using namespace std;
 
 namespace mitten
 {
-	MittenSource::MittenSource()
+	MittenSource::MittenSource() : tokenCache(NULL)
 	{
-		lexer.deliminate(" ") = Filtered;
-		lexer.deliminate("\t") = Filtered;
-		lexer.deliminate("\n") = Filtered;
-		lexer.deliminate("(");
-		lexer.deliminate(")");
-		lexer.deliminate(",");
-		lexer.deliminate("{");
-		lexer.deliminate("}");
-		lexer.deliminate(";");
-		lexer.deliminate("[");
-		lexer.deliminate("]");
-		lexer.deliminate("\"", "\"");
-		lexer.deliminate("'", "'");
-		lexer.deliminate("\"\"\"", "\"\"\"");
-		lexer.deliminate("//", "\n") = Filtered;
-		lexer.deliminate("/*", "*/") = Filtered;
-		lexer.deliminate("+");
-		lexer.deliminate("-");
-		lexer.deliminate("*");
-		lexer.deliminate("/");
-		lexer.deliminate("%");
-		lexer.deliminate("&");
-		lexer.deliminate("|");
-		lexer.deliminate("^");
-		lexer.deliminate("<<");
-		lexer.deliminate(">>");
-		lexer.deliminate("~");
-		lexer.deliminate("&&");
-		lexer.deliminate("||");
-		lexer.deliminate("^^");
-		lexer.deliminate("!");
-		lexer.deliminate("=");
-		lexer.deliminate("+=");
-		lexer.deliminate("-=");
-		lexer.deliminate("*=");
-		lexer.deliminate("/=");
-		lexer.deliminate("%=");
-		lexer.deliminate("&=");
-		lexer.deliminate("|=");
-		lexer.deliminate("^=");
-		lexer.deliminate("<<=");
-		lexer.deliminate(">>=");
-		lexer.deliminate("~=");
-		lexer.deliminate("==");
-		lexer.deliminate("!=");
-		lexer.deliminate("<");
-		lexer.deliminate("<=");
-		lexer.deliminate(">");
-		lexer.deliminate(">=");
-		lexer.deliminate(":");
-
+		lexer.keywords = MittenKeywords();
 		structureParser.setGlobalBoundName("global");
 		structureParser.setGlobalSplit("line", ";");
 		structureParser.bind("expression", "(", ")", "argument", ",");
@@ -104,7 +54,7 @@ namespace mitten
 	{
 		MittenSource rtn;
 		rtn.path = "--";
-		rtn.body = s;
+		rtn.source = SourceBuffer::fromString(s, rtn.path);
 		return rtn;
 	}
 
@@ -112,10 +62,15 @@ namespace mitten
 	{
 		MittenSource rtn;
 		rtn.path = p;
-		rtn.body = readFile8(p);
+		rtn.source = SourceBuffer::fromFile(p);
 		return rtn;
 	}
 
+	void MittenSource::setTokenCache(TokenCache *c)
+	{
+		tokenCache = c;
+	}
+
 	void MittenSource::onNode(AST &a, ASTBuilder &b, ErrorHandler &e, StructureParser &p)
 	{
 		MittenErrorHandler &meh = dynamic_cast<MittenErrorHandler &>(e);
@@ -126,7 +81,7 @@ namespace mitten
 
 			if (a.size() == 2)
 			{
-				if (a[0].isLeaf() && a[0].leaf().value().compare("include") == 0)
+				if (a[0].isLeaf() && a[0].leaf().keyword() == IncludeKeyword)
 				{
 					if (a[1].isBranch())
 					{
@@ -170,7 +125,7 @@ namespace mitten
 
 	AST MittenSource::parse()
 	{
-		vector<Token> toks = lexer.lex(body, path, meh);
+		vector<Token> toks = (tokenCache != NULL ? tokenCache->lex(lexer, source, meh) : lexer.lex(source, meh));
 		return structureParser.parse(toks, meh);
 	}
 
@@ -183,6 +138,8 @@ namespace mitten
 
 	bool MittenSource::compile()
 	{
-		compileFromAST(parse());
+		// The tokens and files of a source are only needed while it compiles.
+		SourceTable::Scope scope;
+		return compileFromAST(parse());
 	}
 }
@@ -40,6 +40,7 @@
 #include <iostream>
 #include <MPTK.h>
 #include "MittenErrorHandler.h"
+#include "MittenLexer.h"
 
 namespace mitten
 {
@@ -47,10 +48,11 @@ namespace mitten
 	{
 	protected:
 		std::string path;
-		std::string body;
+		std::shared_ptr<const SourceBuffer> source;
 		MittenErrorHandler meh;
-		Lexer lexer;
+		MittenLexer lexer;
 		StructureParser structureParser;
+		TokenCache *tokenCache;
 
 	public:
 		MittenSource();
@@ -58,6 +60,8 @@ namespace mitten
 		static MittenSource fromString(std::string s);
 		static MittenSource fromFile(std::string p);
 
+		void setTokenCache(TokenCache *c);
+
 		static void onNode(AST &a, ASTBuilder &b, ErrorHandler &e, StructureParser &p);
 
 		AST parse();
@@ -47,7 +47,7 @@ namespace mitten
 
 	bool PreProcessor::isIncludeDirective(AST a)
 	{
-		return (a[0].isLeaf() && a[0].leaf().value().compare("include") == 0);
+		return (a[0].isLeaf() && a[0].leaf().keyword() == IncludeKeyword);
 	}
 
 	bool PreProcessor::expectDirectiveCall(AST a, MittenErrorHandler &meh)
@@ -40,6 +40,7 @@
 #include <iostream>
 #include <MPTK.h>
 #include "MittenErrorHandler.h"
+#include "MittenLexer.h"
 
 namespace mitten
 {
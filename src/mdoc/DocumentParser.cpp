@@ -40,10 +40,55 @@ using namespace std;
 
 namespace mitten
 {
-	Lexer __mdocLexer;
-	Lexer __mdocCommandLexer;
-	Lexer __mdocTextLexer;
-	bool __mdocInitted = false;
+	// In the order of CommandKeyword.
+	static const char *commandNames[] = {
+		"title",
+		"subtitle",
+		"author",
+		"date",
+		"begin",
+		"end",
+		"section",
+		"subsection",
+		"subsubsection",
+		"subsubsubsection",
+		"appendix",
+		"newline",
+		"newpage",
+		"abstract",
+		"figure",
+		"code",
+		"algorithm",
+		"list",
+		"axiom",
+		"theorem",
+		"correlary"
+	};
+
+	static string stripString(string s)
+	{
+		size_t b = s.find_first_not_of(" \t\r\n");
+		if (b == string::npos)
+			return "";
+		return s.substr(b, s.find_last_not_of(" \t\r\n")-b+1);
+	}
+
+	// References and strings cannot span lines: they end at their closing
+	// character, or else just before the end of the line.
+	static Lexer::DeliminatorPatternCallback closedOnLine(char close)
+	{
+		return [close](StringRef s, size_t) -> size_t
+		{
+			for (size_t i = 1; i < s.size(); i++)
+			{
+				if (s[i] == close)
+					return i+1;
+				else if (s[i] == '\n')
+					return i;
+			}
+			return s.size();
+		};
+	}
 
 	void DocumentParser::onText(string t)
 	{
@@ -222,20 +267,19 @@ namespace mitten
 
 	void DocumentParser::error(Token source, string message)
 	{
-		errorPage += path+":"+to_string(source.line)+":"+to_string(source.column)+" - "+message+"\n";
+		errorPage += path+":"+to_string(source.line())+":"+to_string(source.column())+" - "+message+"\n";
 		errorCount++;
 	}
 
-	void DocumentParser::handleCommand(Token tok, string command)
+	void DocumentParser::handleCommand(Token tok, const vector<Token> &ctoks)
 	{
-		vector<Token> ctoks = __mdocCommandLexer.lex(command);
-
 		if (ctoks.empty())
 		{
 			error(tok, "empty command.");
+			return;
 		}
 
-		if (ctoks[0].value.compare("title") == 0)
+		if (ctoks[0].keyword() == TitleCommand)
 		{
 			if (ctoks.size() != 2)
 			{
@@ -243,21 +287,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onTitle(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)));
+					onTitle(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("subtitle") == 0)
+		else if (ctoks[0].keyword() == SubtitleCommand)
 		{
 			if (ctoks.size() != 2)
 			{
@@ -265,21 +309,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onSubtitle(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)));
+					onSubtitle(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("author") == 0)
+		else if (ctoks[0].keyword() == AuthorCommand)
 		{
 			if (ctoks.size() != 2)
 			{
@@ -287,21 +331,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onAuthor(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)));
+					onAuthor(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("date") == 0)
+		else if (ctoks[0].keyword() == DateCommand)
 		{
 			if (ctoks.size() != 2)
 			{
@@ -309,21 +353,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onDate(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)));
+					onDate(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("begin") == 0)
+		else if (ctoks[0].keyword() == BeginCommand)
 		{
 			if (ctoks.size() < 2)
 			{
@@ -331,11 +375,11 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value.compare("abstract") == 0)
+				if (ctoks[1].keyword() == AbstractScope)
 				{
 					onBeginAbstract();
 				}
-				else if (ctoks[1].value.compare("figure") == 0)
+				else if (ctoks[1].keyword() == FigureScope)
 				{
 					if (ctoks.size() != 4)
 					{
@@ -343,30 +387,30 @@ namespace mitten
 					}
 					else
 					{
-						if (ctoks[2].value[0] != '\"')
+						if (ctoks[2].value()[0] != '\"')
 						{
 							error(ctoks[2], "expected string.");
 						}
-						else if (ctoks[2].value.back() != '\"')
+						else if (ctoks[2].value().back() != '\"')
 						{
 							error(ctoks[2], "incomplete string constant.");
 						}
 						else
 						{
-							onBeginFigure(stripString(ctoks[2].value.substr(1, ctoks[2].value.size()-2)), stripString(ctoks[3].value));
+							onBeginFigure(stripString(ctoks[2].value().substr(1, ctoks[2].value().size()-2)), stripString(ctoks[3].value()));
 						}
 					}
 				}
-				else if (ctoks[1].value.compare("code") == 0)
+				else if (ctoks[1].keyword() == CodeScope)
 				{
 					onBeginCode();
 				}
-				else if (ctoks[1].value.compare("algorithm") == 0)
+				else if (ctoks[1].keyword() == AlgorithmScope)
 				{
 					onBeginAlgorithm();
 					currentlyInAlgorithm = true;
 				}
-				else if (ctoks[1].value.compare("list") == 0)
+				else if (ctoks[1].keyword() == ListScope)
 				{
 					if (ctoks.size() == 2)
 					{
@@ -375,21 +419,21 @@ namespace mitten
 					else if (ctoks.size() == 3)
 					{
 						ListType lt = BulletType;
-						if (ctoks[2].value.compare("bullet") == 0)
+						if (ctoks[2].value().compare("bullet") == 0)
 						{
 							lt = BulletType;
 						}
-						else if (ctoks[2].value.compare("numbered") == 0)
+						else if (ctoks[2].value().compare("numbered") == 0)
 						{
 							lt = NumberedType;
 						}
-						else if (ctoks[2].value.compare("labeled") == 0)
+						else if (ctoks[2].value().compare("labeled") == 0)
 						{
 							lt = LabeledType;
 						}
 						else
 						{
-							error(ctoks[2], "unknown list type '"+ctoks[2].value+"'.");
+							error(ctoks[2], "unknown list type '"+ctoks[2].value()+"'.");
 						}
 
 						onBeginList(lt);
@@ -397,47 +441,47 @@ namespace mitten
 					else if (ctoks.size() == 4)
 					{
 						ListType lt = NumberedType;
-						if (ctoks[2].value.compare("bullet") == 0)
+						if (ctoks[2].value().compare("bullet") == 0)
 						{
-							error(ctoks[2], "unexpected list type '"+ctoks[2].value+"'.");
+							error(ctoks[2], "unexpected list type '"+ctoks[2].value()+"'.");
 						}
-						else if (ctoks[2].value.compare("numbered") == 0)
+						else if (ctoks[2].value().compare("numbered") == 0)
 						{
 							lt = NumberedType;
 						}
-						else if (ctoks[2].value.compare("labeled") == 0)
+						else if (ctoks[2].value().compare("labeled") == 0)
 						{
-							error(ctoks[2], "unexpected list type '"+ctoks[2].value+"'.");
+							error(ctoks[2], "unexpected list type '"+ctoks[2].value()+"'.");
 						}
 						else
 						{
-							error(ctoks[2], "unknown list type '"+ctoks[2].value+"'.");
+							error(ctoks[2], "unknown list type '"+ctoks[2].value()+"'.");
 						}
 
 						ListNumberingType lnt;
-						if (ctoks[3].value.compare("numbers") == 0)
+						if (ctoks[3].value().compare("numbers") == 0)
 						{
 							lnt = Numbers;
 						}
-						else if (ctoks[3].value.compare("LETTERS") == 0)
+						else if (ctoks[3].value().compare("LETTERS") == 0)
 						{
 							lnt = LettersUpper;
 						}
-						else if (ctoks[3].value.compare("letters") == 0)
+						else if (ctoks[3].value().compare("letters") == 0)
 						{
 							lnt = LettersLower;
 						}
-						else if (ctoks[3].value.compare("NUMERALS") == 0)
+						else if (ctoks[3].value().compare("NUMERALS") == 0)
 						{
 							lnt = NumeralsUpper;
 						}
-						else if (ctoks[3].value.compare("numerals") == 0)
+						else if (ctoks[3].value().compare("numerals") == 0)
 						{
 							lnt = NumeralsLower;
 						}
 						else
 						{
-							error(ctoks[3], "unknown list numbering type '"+ctoks[3].value+"'.");
+							error(ctoks[3], "unknown list numbering type '"+ctoks[3].value()+"'.");
 						}
 
 						onBeginList(lt, lnt);
@@ -447,7 +491,7 @@ namespace mitten
 						error(ctoks[1], "scope 'list' expects 0-2 arguments.");
 					}
 				}
-				else if (ctoks[1].value.compare("axiom") == 0)
+				else if (ctoks[1].keyword() == AxiomScope)
 				{
 					if (ctoks.size() != 4)
 					{
@@ -455,21 +499,21 @@ namespace mitten
 					}
 					else
 					{
-						if (ctoks[2].value[0] != '\"')
+						if (ctoks[2].value()[0] != '\"')
 						{
 							error(ctoks[2], "expected string.");
 						}
-						else if (ctoks[2].value.back() != '\"')
+						else if (ctoks[2].value().back() != '\"')
 						{
 							error(ctoks[2], "incomplete string constant.");
 						}
 						else
 						{
-							onBeginAxiom(stripString(ctoks[2].value.substr(1, ctoks[2].value.size()-2)), stripString(ctoks[3].value));
+							onBeginAxiom(stripString(ctoks[2].value().substr(1, ctoks[2].value().size()-2)), stripString(ctoks[3].value()));
 						}
 					}
 				}
-				else if (ctoks[1].value.compare("theorem") == 0)
+				else if (ctoks[1].keyword() == TheoremScope)
 				{
 					if (ctoks.size() != 4)
 					{
@@ -477,21 +521,21 @@ namespace mitten
 					}
 					else
 					{
-						if (ctoks[2].value[0] != '\"')
+						if (ctoks[2].value()[0] != '\"')
 						{
 							error(ctoks[2], "expected string.");
 						}
-						else if (ctoks[2].value.back() != '\"')
+						else if (ctoks[2].value().back() != '\"')
 						{
 							error(ctoks[2], "incomplete string constant.");
 						}
 						else
 						{
-							onBeginTheorem(stripString(ctoks[2].value.substr(1, ctoks[2].value.size()-2)), stripString(ctoks[3].value));
+							onBeginTheorem(stripString(ctoks[2].value().substr(1, ctoks[2].value().size()-2)), stripString(ctoks[3].value()));
 						}
 					}
 				}
-				else if (ctoks[1].value.compare("correlary") == 0)
+				else if (ctoks[1].keyword() == CorrelaryScope)
 				{
 					if (ctoks.size() != 5)
 					{
@@ -499,27 +543,27 @@ namespace mitten
 					}
 					else
 					{
-						if (ctoks[2].value[0] != '\"')
+						if (ctoks[2].value()[0] != '\"')
 						{
 							error(ctoks[2], "expected string.");
 						}
-						else if (ctoks[2].value.back() != '\"')
+						else if (ctoks[2].value().back() != '\"')
 						{
 							error(ctoks[2], "incomplete string constant.");
 						}
 						else
 						{
-							onBeginCorrelary(stripString(ctoks[2].value.substr(1, ctoks[2].value.size()-2)), stripString(ctoks[3].value), stripString(ctoks[4].value));
+							onBeginCorrelary(stripString(ctoks[2].value().substr(1, ctoks[2].value().size()-2)), stripString(ctoks[3].value()), stripString(ctoks[4].value()));
 						}
 					}
 				}
 				else
 				{
-					error(ctoks[1], "unknown scope '"+ctoks[1].value+"'.");
+					error(ctoks[1], "unknown scope '"+ctoks[1].value()+"'.");
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("end") == 0)
+		else if (ctoks[0].keyword() == EndCommand)
 		{
 			if (ctoks.size() != 2)
 			{
@@ -527,46 +571,46 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value.compare("abstract") == 0)
+				if (ctoks[1].keyword() == AbstractScope)
 				{
 					onEndAbstract();
 				}
-				else if (ctoks[1].value.compare("figure") == 0)
+				else if (ctoks[1].keyword() == FigureScope)
 				{
 					onEndFigure();
 				}
-				else if (ctoks[1].value.compare("code") == 0)
+				else if (ctoks[1].keyword() == CodeScope)
 				{
 					onEndCode();
 				}
-				else if (ctoks[1].value.compare("algorithm") == 0)
+				else if (ctoks[1].keyword() == AlgorithmScope)
 				{
 					onEndAlgorithm();
 					currentlyInAlgorithm = false;
 				}
-				else if (ctoks[1].value.compare("list") == 0)
+				else if (ctoks[1].keyword() == ListScope)
 				{
 					onEndList();
 				}
-				else if (ctoks[1].value.compare("axiom") == 0)
+				else if (ctoks[1].keyword() == AxiomScope)
 				{
 					onEndAxiom();
 				}
-				else if (ctoks[1].value.compare("theorem") == 0)
+				else if (ctoks[1].keyword() == TheoremScope)
 				{
 					onEndTheorem();
 				}
-				else if (ctoks[1].value.compare("correlary") == 0)
+				else if (ctoks[1].keyword() == CorrelaryScope)
 				{
 					onEndCorrelary();
 				}
 				else
 				{
-					error(ctoks[1], "unknown scope '"+ctoks[1].value+"'.");
+					error(ctoks[1], "unknown scope '"+ctoks[1].value()+"'.");
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("section") == 0)
+		else if (ctoks[0].keyword() == SectionCommand)
 		{
 			if (ctoks.size() != 3)
 			{
@@ -574,21 +618,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onSection(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)), stripString(ctoks[2].value));
+					onSection(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)), stripString(ctoks[2].value()));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("subsection") == 0)
+		else if (ctoks[0].keyword() == SubSectionCommand)
 		{
 			if (ctoks.size() != 3)
 			{
@@ -596,21 +640,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onSubSection(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)), stripString(ctoks[2].value));
+					onSubSection(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)), stripString(ctoks[2].value()));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("subsubsection") == 0)
+		else if (ctoks[0].keyword() == SubSubSectionCommand)
 		{
 			if (ctoks.size() != 3)
 			{
@@ -618,21 +662,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onSubSubSection(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)), stripString(ctoks[2].value));
+					onSubSubSection(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)), stripString(ctoks[2].value()));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("subsubsubsection") == 0)
+		else if (ctoks[0].keyword() == SubSubSubSectionCommand)
 		{
 			if (ctoks.size() != 3)
 			{
@@ -640,21 +684,21 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onSubSubSubSection(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)), stripString(ctoks[2].value));
+					onSubSubSubSection(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)), stripString(ctoks[2].value()));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("appendix") == 0)
+		else if (ctoks[0].keyword() == AppendixCommand)
 		{
 			if (ctoks.size() != 3)
 			{
@@ -662,139 +706,180 @@ namespace mitten
 			}
 			else
 			{
-				if (ctoks[1].value[0] != '\"')
+				if (ctoks[1].value()[0] != '\"')
 				{
 					error(ctoks[1], "expected string.");
 				}
-				else if (ctoks[1].value.back() != '\"')
+				else if (ctoks[1].value().back() != '\"')
 				{
 					error(ctoks[1], "incomplete string constant.");
 				}
 				else
 				{
-					onAppendix(stripString(ctoks[1].value.substr(1, ctoks[1].value.size()-2)), stripString(ctoks[2].value));
+					onAppendix(stripString(ctoks[1].value().substr(1, ctoks[1].value().size()-2)), stripString(ctoks[2].value()));
 				}
 			}
 		}
-		else if (ctoks[0].value.compare("newline") == 0)
+		else if (ctoks[0].keyword() == NewLineCommand)
 		{
 			onNewLine();
 		}
-		else if (ctoks[0].value.compare("newpage") == 0)
+		else if (ctoks[0].keyword() == NewPageCommand)
 		{
 			onNewPage();
 		}
 		else
 		{
-			error(ctoks[0], "unknown command '"+ctoks[0].value+"'.");
+			error(ctoks[0], "unknown command '"+ctoks[0].value()+"'.");
 		}
 	}
 
-	void DocumentParser::init()
+	DocumentParser::DocumentParser() : errorCount(0), currentlyInAlgorithm(false)
 	{
-		if (!__mdocInitted)
-		{
-			__mdocLexer.deliminate("#", "\n");
-			__mdocLexer.deliminate("\n") = Filtered;
+		// Text is lexed line by line, split around references; '#' switches to
+		// the command grammar for the rest of the line.
+		lexer.mode("text").deliminate("\n") = Filtered;
+		lexer.mode("text").deliminate("[", closedOnLine(']'));
+		lexer.push("text", "#", "command");
 
-			__mdocCommandLexer.deliminate(" ") = Filtered;
-			__mdocCommandLexer.deliminate("\t") = Filtered;
-			__mdocCommandLexer.deliminate("\"", "\"");
+		lexer.mode("command").deliminate(" ") = Filtered;
+		lexer.mode("command").deliminate("\t") = Filtered;
+		lexer.mode("command").deliminate("\"", closedOnLine('\"'));
+		lexer.pop("command", "\n") = Filtered;
+		for (auto i : commandNames)
+			lexer.mode("command").keyword(i);
 
-			__mdocTextLexer.deliminate("[", "]");
-		}
+		textMode = lexer.modeIndex("text");
+		commandMode = lexer.modeIndex("command");
 	}
 
-	void DocumentParser::read(string p)
+	void DocumentParser::handleLine(const vector<Token> &ltoks, bool &lastWasText)
 	{
-		path = p;
-		body = readFile(p);
-	}
+		if (ltoks.empty())
+			return;
 
-	bool DocumentParser::parse()
-	{
-		if (!__mdocInitted)
+		if (currentlyInAlgorithm)
 		{
-			init();
-		}
+			lastWasText = false;
 
-		vector<Token> toks = __mdocLexer.lex(body);
+			StringRef whole = body->view().substr(ltoks.front().offset(), ltoks.back().offset()+ltoks.back().length()-ltoks.front().offset());
+			string line = stripString(whole.str());
 
-		bool lastWasText = false;
-
-		for (auto i : toks)
-		{
-			if (i.value.empty())
+			if (line.empty())
 			{
-				continue;
+				return;
 			}
-			else if (i.value[0] == '#')
+			else if (line.back() == '{')
 			{
-				if (i.value.size() > 1)
+				line = stripString(line.substr(0, line.size()-1));
+				if (line.empty())
+				{
+					error(ltoks.front(), "'{' must be on same line.");
+				}
+				else if (line.find(" ") != string::npos)
 				{
-					handleCommand(i, i.value.substr(1, i.value.size()-2));
+					string sn = line.substr(0, line.find(" "));
+					string s = line.substr(line.find(" ")+1);
+					onAlgorithmBeginStatement(stripString(sn), stripString(s));
 				}
 				else
 				{
-					error(i, "empty command.");
+					onAlgorithmBeginStatement(stripString(line), "");
 				}
-
-				lastWasText = false;
 			}
-			else if (currentlyInAlgorithm)
+			else if (line.compare("}") == 0)
 			{
-				lastWasText = false;
-
-				string line = stripString(i.value);
+				onAlgorithmEndStatement();
+			}
+			else
+			{
+				onAlgorithmInstruction(line);
+			}
+		}
+		else
+		{
+			if (lastWasText)
+				onNewParagraph();
 
-				if (line.back() == '{')
+			for (auto &j : ltoks)
+			{
+				string v = j.value();
+				if (v[0] == '[')
 				{
-					line = stripString(line.substr(0, line.size()-1));
-					if (line.compare("{") == 0)
-					{
-						error(i, "'{' must be on same line.");
-					}
-					else if (line.find(" ") != string::npos)
-					{
-						string sn = line.substr(0, line.find(" "));
-						string s = line.substr(line.find(" ")+1);
-						onAlgorithmBeginStatement(stripString(sn), stripString(s));
-					}
+					if (v.size() < 2 || v.back() != ']')
+						error(j, "incomplete reference.");
 					else
-					{
-						onAlgorithmBeginStatement(stripString(line), "");
-					}
-				}
-				else if (line.compare("}") == 0)
-				{
-					onAlgorithmEndStatement();
+						onReference(stripString(v.substr(1, v.size()-2)));
 				}
 				else
 				{
-					onAlgorithmInstruction(line);
+					onText(stripString(v));
 				}
 			}
-			else
-			{
-				if (lastWasText)
-					onNewParagraph();
 
-				vector<Token> ttoks = __mdocTextLexer.lex(i.value);
-				for (auto j : ttoks)
+			lastWasText = true;
+		}
+	}
+
+	void DocumentParser::read(string p)
+	{
+		path = p;
+		body = SourceBuffer::fromFile(p);
+	}
+
+	bool DocumentParser::parse()
+	{
+		// Everything is handed on as strings, so no token outlives the parse.
+		SourceTable::Scope scope;
+		InternalErrorHandler eh;
+		bool lastWasText = false;
+		bool inCommand = false;
+		Token command;
+		vector<Token> ctoks;
+		vector<Token> ltoks;
+
+		// The document is lexed in one pass; commands and text lines are
+		// handled as soon as their last token is seen.
+		auto sink = [&](const Token &t, size_t m)
+		{
+			if (m == commandMode)
+			{
+				if (!t.filtered())
 				{
-					if (j.value[0] == '[')
-					{
-						onReference(stripString(j.value.substr(1, j.value.size()-2)));
-					}
-					else
-					{
-						onText(stripString(j.value));
-					}
+					ctoks.push_back(t);
 				}
+				else if (t.view() == "\n")
+				{
+					handleCommand(command, ctoks);
+					inCommand = false;
+				}
+			}
+			else if (t.filtered())
+			{
+				handleLine(ltoks, lastWasText);
+				ltoks.clear();
+			}
+			else if (t.view() == "#")
+			{
+				handleLine(ltoks, lastWasText);
+				ltoks.clear();
 
-				lastWasText = true;
+				command = t;
+				ctoks.clear();
+				inCommand = true;
+				lastWasText = false;
 			}
-		}
+			else
+			{
+				ltoks.push_back(t);
+			}
+		};
+
+		lexer.lexTo(body, eh, sink);
+
+		if (inCommand)
+			handleCommand(command, ctoks);
+		handleLine(ltoks, lastWasText);
 
 		return (errorCount == 0);
 	}
@@ -63,11 +63,37 @@ namespace mitten
 		NumeralsLower
 	} ListNumberingType;
 
+	typedef enum
+	{
+		NoCommand,
+		TitleCommand,
+		SubtitleCommand,
+		AuthorCommand,
+		DateCommand,
+		BeginCommand,
+		EndCommand,
+		SectionCommand,
+		SubSectionCommand,
+		SubSubSectionCommand,
+		SubSubSubSectionCommand,
+		AppendixCommand,
+		NewLineCommand,
+		NewPageCommand,
+		AbstractScope,
+		FigureScope,
+		CodeScope,
+		AlgorithmScope,
+		ListScope,
+		AxiomScope,
+		TheoremScope,
+		CorrelaryScope
+	} CommandKeyword;
+
 	class DocumentParser
 	{
 	protected:
 		std::string path;
-		std::string body;
+		std::shared_ptr<const SourceBuffer> body;
 
 		virtual void onText(std::string t);
 		virtual void onReference(std::string r);
@@ -113,12 +139,14 @@ namespace mitten
 
 		bool currentlyInAlgorithm, currentlyInList;
 
-		void handleCommand(Token tok, std::string command);
+		ModalLexer lexer;
+		size_t textMode, commandMode;
 
-	public:
-		DocumentParser() : errorCount(0), currentlyInAlgorithm(false) {}
+		void handleCommand(Token tok, const std::vector<Token> &ctoks);
+		void handleLine(const std::vector<Token> &ltoks, bool &lastWasText);
 
-		static void init();
+	public:
+		DocumentParser();
 
 		void read(std::string p);
 
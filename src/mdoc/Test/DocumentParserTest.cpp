@@ -0,0 +1,96 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <MUnit.h>
+
+#include "../DocumentParser.h"
+
+using namespace std;
+using namespace mitten;
+
+class RecordingParser : public DocumentParser
+{
+protected:
+	void onText(string t) {}
+	void onNewParagraph() {}
+	void onReference(string r) { references.push_back(r); }
+	void onTitle(string t) { titles.push_back(t); }
+	void onSection(string s, string r) { sections.push_back(s+" "+r); }
+
+public:
+	vector<string> references, titles, sections;
+};
+
+bool parseText(RecordingParser &p, string text)
+{
+	string path = "DocumentParserTest.tmp";
+	ofstream out(path.c_str());
+	out << text;
+	out.close();
+	p.read(path);
+	bool rtn = p.parse();
+	remove(path.c_str());
+	return rtn;
+}
+
+int main()
+{
+	Test test = Test("DocumentParserTest");
+
+	RecordingParser wellFormed;
+	test.assert(parseText(wellFormed, "#title \"A [b] title\"\nSee [ref1] and [ref2].\n#section \"Intro\" intro\n"));
+	test.assert(wellFormed.titles.size() == 1 && wellFormed.titles[0] == "A [b] title");
+	test.assert(wellFormed.references.size() == 2 && wellFormed.references[1] == "ref2");
+	test.assert(wellFormed.sections.size() == 1 && wellFormed.sections[0] == "Intro intro");
+
+	RecordingParser unclosedReference;
+	test.assert(!parseText(unclosedReference, "See [ref1 here.\nMore text.\n#section \"Intro\" intro\n"));
+	test.assert(unclosedReference.dumpErrors().find("incomplete reference.") != string::npos);
+	test.assert(unclosedReference.references.empty());
+	test.assert(unclosedReference.sections.size() == 1 && unclosedReference.sections[0] == "Intro intro");
+
+	RecordingParser unclosedString;
+	test.assert(!parseText(unclosedString, "#title \"Broken\n#section \"Intro\" intro\n"));
+	test.assert(unclosedString.dumpErrors().find("incomplete string constant.") != string::npos);
+	test.assert(unclosedString.dumpErrors().find("expects 1 argument") == string::npos);
+	test.assert(unclosedString.sections.size() == 1 && unclosedString.sections[0] == "Intro intro");
+
+	return (int)(test.write());
+}
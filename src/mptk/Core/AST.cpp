@@ -56,6 +56,17 @@ namespace mitten
 		return tmp;
 	}
 
+	AST AST::createLazyNode(string n, shared_ptr<const vector<Token> > t, size_t f, size_t l, Expander x)
+	{
+		AST tmp = createNode(n);
+		tmp.deferred = make_shared<Deferred>();
+		tmp.deferred->tokens = t;
+		tmp.deferred->first = f;
+		tmp.deferred->last = l;
+		tmp.deferred->expander = x;
+		return tmp;
+	}
+
 	bool AST::isLeaf()
 	{
 		return !isBranched;
@@ -66,6 +77,39 @@ namespace mitten
 		return isBranched;
 	}
 
+	bool AST::isLazy()
+	{
+		return (deferred != NULL);
+	}
+
+	void AST::expand()
+	{
+		if (!deferred)
+			return;
+
+		// The node is no longer lazy while its branches are built, so that the expander can append to it.
+		shared_ptr<Deferred> d = deferred;
+		deferred.reset();
+		if (d->expanded)
+		{
+			*this = *(d->expanded);
+			return;
+		}
+
+		d->expander(*this, *(d->tokens), d->first, d->last);
+
+		// Kept only if copies of the node are still lazy.
+		if (d.use_count() > 1)
+			d->expanded = make_shared<AST>(*this);
+	}
+
+	vector<Token> AST::deferredTokens()
+	{
+		if (!deferred)
+			return vector<Token>();
+		return vector<Token>(deferred->tokens->begin()+deferred->first, deferred->tokens->begin()+deferred->last);
+	}
+
 	string &AST::name()
 	{
 		return nameValue;
@@ -80,6 +124,7 @@ namespace mitten
 
 	size_t AST::size()
 	{
+		expand();
 		if (!isBranched)
 			throw runtime_error("cannot get size of AST leaf");
 		return branchValues.size();
@@ -87,6 +132,7 @@ namespace mitten
 
 	AST &AST::operator [] (size_t n)
 	{
+		expand();
 		if (!isBranched)
 			throw runtime_error("cannot get element from AST leaf");
 		return branchValues[n];
@@ -94,6 +140,7 @@ namespace mitten
 
 	vector<AST>::iterator AST::begin()
 	{
+		expand();
 		if (!isBranched)
 			throw runtime_error("cannot get iterator for AST leaf");
 		return branchValues.begin();
@@ -101,6 +148,7 @@ namespace mitten
 
 	vector<AST>::iterator AST::end()
 	{
+		expand();
 		if (!isBranched)
 			throw runtime_error("cannot get iterator for AST leaf");
 		return branchValues.end();
@@ -108,6 +156,7 @@ namespace mitten
 
 	AST &AST::rightmost()
 	{
+		expand();
 		if (!isBranched || branchValues.empty())
 			return *this;
 		else
@@ -116,6 +165,7 @@ namespace mitten
 
 	void AST::append(AST a)
 	{
+		expand();
 		branchValues.push_back(a);
 	}
 
@@ -126,12 +176,13 @@ namespace mitten
 
 	string AST::display()
 	{
+		expand();
 		stringstream ss;
 
 		if (isBranched)
 		{
 			ss << "(" << nameValue << ":";
-			for (auto i : branchValues)
+			for (auto &i : branchValues)
 				ss << " " << i.display();
 			if (branchValues.empty())
 				ss << "null";
@@ -139,7 +190,7 @@ namespace mitten
 		}
 		else
 		{
-			ss << "'" << leafValue.value() << "'";
+			ss << "'" << leafValue.view() << "'";
 		}
 
 		return ss.str();
@@ -42,6 +42,8 @@
 #include <vector>
 #include <sstream>
 #include <stdexcept>
+#include <memory>
+#include <functional>
 
 #include "Token.h"
 
@@ -51,11 +53,31 @@ namespace mitten
 	 */
 	class AST
 	{
+	public:
+		/*! \brief Callback which builds the branches of a lazy node.
+		 * The arguments are the node, which has no branches yet, and the token vector and range [first, last)
+		 * the node was created with.
+		 */
+		typedef std::function<void (AST &, const std::vector<Token> &, size_t, size_t)> Expander;
+
 	protected:
+		/*! \brief Helper type.
+		 * The unparsed token range of a lazy node, shared by its copies.
+		 */
+		typedef struct Deferred
+		{
+			std::shared_ptr<const std::vector<Token> > tokens; //! The token vector the range is in.
+			size_t first; //! The first token of the range.
+			size_t last; //! One past the last token of the range.
+			Expander expander; //! Builds the branches from the range.
+			std::shared_ptr<AST> expanded; //! The node as built by the first copy expanded, for the other copies.
+		} Deferred;
+
 		bool isBranched; //! True only if the current node has branches.
 		Token leafValue; //! The token to use if the current node is a leaf.
 		std::string nameValue; //! The name of the node if it is a branch.
 		std::vector<AST> branchValues; //! The branches if the current node is not a leaf.
+		std::shared_ptr<Deferred> deferred; //! The range the branches are yet to be built from, NULL unless the node is lazy.
 
 	public:
 		/*! \brief Constructor.
@@ -73,6 +95,14 @@ namespace mitten
 		 */
 		static AST createNode(std::string n);
 
+		/*! \brief Constructor.
+		 * Creates a lazy AST branch node with name \p n, whose branches are built by \p x from the tokens
+		 * [f, l) of \p t when first needed: by size(), operator [], begin(), end(), rightmost(), append() or
+		 * display(). Copies of the node made before then share the result, so \p x runs once. Expanding a
+		 * node modifies it, so lazy nodes must not be read from several threads at once.
+		 */
+		static AST createLazyNode(std::string n, std::shared_ptr<const std::vector<Token> > t, size_t f, size_t l, Expander x);
+
 		/*! \brief Checks if the node is a leaf. 
 		 */
 		bool isLeaf();
@@ -81,6 +111,18 @@ namespace mitten
 		 */
 		bool isBranch();
 
+		/*! \brief Checks if the node is lazy and its branches have not been built yet.
+		 */
+		bool isLazy();
+
+		/*! \brief Builds the branches of a lazy node now; does nothing for other nodes.
+		 */
+		void expand();
+
+		/*! \brief Gets the tokens a lazy node has not parsed yet, none for other nodes.
+		 */
+		std::vector<Token> deferredTokens();
+
 		/*! \brief Gets a reference to the name of the node.
 		 */
 		std::string &name();
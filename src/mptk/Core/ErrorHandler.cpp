@@ -48,9 +48,12 @@ namespace mitten
 		page += to_string(source.line())+":"+to_string(source.column())+" - "+message+"\n";
 		page += "    from '"+source.value()+"'\n";
 
-		if (!filebody.empty())
+		SourceTable &table = SourceTable::global();
+		StringRef text;
+		if ((!source.owned() && table.lineText(source.fileId(), source.line(), text)) || 
+			(hasFileBody && table.lineText(filebody, source.line(), text)))
 		{
-			page += filebody[source.line()-1]+"\n";
+			page += text.str()+"\n";
 			page += string(source.column(), ' ')+"^\n";
 		}
 
@@ -72,14 +75,8 @@ namespace mitten
 
 	void InternalErrorHandler::setFileBody(string b)
 	{
-		istringstream ss(b);
-
-		while (!ss.eof())
-		{
-			string tmp;
-			getline(ss, tmp);
-			filebody.push_back(tmp);
-		}
+		filebody = SourceTable::global().add(SourceBuffer::fromString(b, filename));
+		hasFileBody = true;
 	}
 
 	void InternalErrorHandler::mismatchedStructureBounds(Token source, std::string start, std::string end)
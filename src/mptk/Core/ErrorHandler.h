@@ -100,7 +100,8 @@ namespace mitten
 	{
 	protected:
 		std::string filename; //! The filename of the file that was parsed.
-		std::vector<std::string> filebody; //! The body of the file that was parsed, split by lines.
+		SourceTable::FileId filebody; //! The body of the file that was parsed, for tokens without source text of their own.
+		bool hasFileBody; //! Whether filebody has been set.
 		std::string page; //! The string containing all the error messages.
 		int count; //! The number of errors produced.
 
@@ -115,7 +116,7 @@ namespace mitten
 		/*! \brief Constructor.
 		 * Initializes an empty internal error handler. 
 		 */
-		InternalErrorHandler() : count(0) {}
+		InternalErrorHandler() : filebody(0), hasFileBody(false), count(0) {}
 
 		/*! \brief Sets the file name.
 		 * Required for file name printing.
@@ -123,7 +124,8 @@ namespace mitten
 		void setFileName(std::string f);
 
 		/*! \brief Sets the file body.
-		 * Also splits it up by lines.
+		 * Only needed for tokens which own their values; the lines quoted for other tokens are looked up
+		 * in the source they were lexed from.
 		 */
 		void setFileBody(std::string b);
 
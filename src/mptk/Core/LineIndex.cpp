@@ -0,0 +1,74 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "LineIndex.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace mitten
+{
+	LineIndex::LineIndex(StringRef b) : body(b)
+	{
+		const char *d = b.data();
+		size_t n = b.size();
+
+		starts.reserve(countBytes(d, d+n, '\n')+1);
+		starts.push_back(0);
+		for (const char *p = d; (p = (const char *)memchr(p, '\n', n-(p-d))) != NULL; p++)
+			starts.push_back((uint32_t)(p-d+1));
+	}
+
+	void LineIndex::position(uint32_t offset, int &line, int &column) const
+	{
+		size_t n = upper_bound(starts.begin(), starts.end(), offset)-starts.begin()-1;
+		line = (int)n+1;
+		column = (int)(offset-starts[n]);
+	}
+
+	StringRef LineIndex::lineText(int line) const
+	{
+		if (line < 1 || (size_t)line > starts.size() || starts[line-1] > body.size())
+			return StringRef();
+
+		size_t b = starts[line-1];
+		size_t e = ((size_t)line < starts.size() ? starts[line]-1 : body.size());
+		return body.substr(b, e-b);
+	}
+}
@@ -0,0 +1,95 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_LINE_INDEX_H
+#define __MITTEN_LINE_INDEX_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "StringRef.h"
+
+namespace mitten
+{
+	/*! \brief Maps byte offsets in a source body to line and column numbers.
+	 * Built once per source by recording where each line starts; lookups are binary searches. The index
+	 * views the body rather than copying it, so line text is only available while the body is.
+	 */
+	class LineIndex
+	{
+	protected:
+		StringRef body; //! The body indexed.
+		std::vector<uint32_t> starts; //! The offset of the start of each line.
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes an index of an empty body.
+		 */
+		LineIndex() : starts(1, 0) {}
+
+		/*! \brief Constructor.
+		 * Indexes a body.
+		 * \param b The body, which must stay valid for as long as line text is needed from the index.
+		 */
+		LineIndex(StringRef b);
+
+		/*! \brief Gets the number of lines. */
+		size_t lines() const { return starts.size(); }
+
+		/*! \brief Finds the line and column number of an offset.
+		 * \param offset The offset into the body.
+		 * \param line Set to the line number (from 1).
+		 * \param column Set to the column number (from 0).
+		 */
+		void position(uint32_t offset, int &line, int &column) const;
+
+		/*! \brief Gets the offset of the start of a line.
+		 * \param line The line number (from 1).
+		 */
+		uint32_t lineStart(int line) const { return starts[line-1]; }
+
+		/*! \brief Gets the text of a line, without its newline.
+		 * \param line The line number (from 1).
+		 * \returns A view of the line, empty if there is no such line.
+		 */
+		StringRef lineText(int line) const;
+	};
+}
+
+#endif
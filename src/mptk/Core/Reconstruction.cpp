@@ -44,9 +44,10 @@ namespace mitten
 	{
 		string page;
 
-		for (auto i : toks)
+		for (auto &i : toks)
 		{
-			page += i.value();
+			StringRef v = i.view();
+			page.append(v.data(), v.size());
 		}
 
 		return page;
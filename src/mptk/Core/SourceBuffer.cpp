@@ -0,0 +1,189 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "SourceBuffer.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace mitten
+{
+	SourceBuffer::SourceBuffer(string p, string b) : _path(p), _body(std::move(b)), _map(NULL), _mapSize(0), _bom(false)
+	{
+		_data = _body.data();
+		_size = _body.size();
+	}
+
+	SourceBuffer::SourceBuffer(string p, void *m, size_t n) : _path(p), _data((const char *)m), _size(n), _map(m), _mapSize(n), _bom(false)
+	{
+		skipBOM();
+	}
+
+	void SourceBuffer::skipBOM()
+	{
+		if (_size >= 3 && memcmp(_data, "\xEF\xBB\xBF", 3) == 0)
+		{
+			_data += 3;
+			_size -= 3;
+			_bom = true;
+		}
+	}
+
+	SourceBuffer::~SourceBuffer()
+	{
+		if (_map != NULL)
+			munmap(_map, _mapSize);
+	}
+
+	shared_ptr<const SourceBuffer> SourceBuffer::fromString(string b, string p)
+	{
+		return shared_ptr<const SourceBuffer>(new SourceBuffer(p, std::move(b)));
+	}
+
+	shared_ptr<const SourceBuffer> SourceBuffer::fromFile(string p)
+	{
+		if (p == "-")
+			return fromDescriptor(0, p);
+
+		int fd = open(p.c_str(), O_RDONLY);
+		if (fd < 0)
+			throw runtime_error("cannot open file for reading: "+p);
+
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+		{
+			void *m = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (m != MAP_FAILED)
+			{
+				close(fd);
+				madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL);
+				return shared_ptr<const SourceBuffer>(new SourceBuffer(p, m, (size_t)st.st_size));
+			}
+		}
+
+		try
+		{
+			shared_ptr<const SourceBuffer> rtn = fromDescriptor(fd, p);
+			close(fd);
+			return rtn;
+		}
+		catch(...)
+		{
+			close(fd);
+			throw;
+		}
+	}
+
+	shared_ptr<const SourceBuffer> SourceBuffer::fromDescriptor(int fd, string p)
+	{
+		string body;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+			body.reserve((size_t)st.st_size);
+
+		char chunk[65536];
+		while (true)
+		{
+			ssize_t n = read(fd, chunk, sizeof(chunk));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+				throw runtime_error("cannot read file: "+p);
+			if (n == 0)
+				break;
+			body.append(chunk, (size_t)n);
+		}
+
+		SourceBuffer *rtn = new SourceBuffer(p, std::move(body));
+		rtn->skipBOM();
+		return shared_ptr<const SourceBuffer>(rtn);
+	}
+
+	long SourceBuffer::fileSize(string p)
+	{
+		struct stat st;
+		if (stat(p.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+			return -1;
+		return (long)st.st_size;
+	}
+
+	const string &SourceBuffer::path() const
+	{
+		return _path;
+	}
+
+	string SourceBuffer::str() const
+	{
+		return string(_data, _size);
+	}
+
+	const char *SourceBuffer::data() const
+	{
+		return _data;
+	}
+
+	size_t SourceBuffer::size() const
+	{
+		return _size;
+	}
+
+	bool SourceBuffer::mapped() const
+	{
+		return (_map != NULL);
+	}
+
+	bool SourceBuffer::hasBOM() const
+	{
+		return _bom;
+	}
+
+	StringRef SourceBuffer::view() const
+	{
+		return StringRef(_data, _size);
+	}
+
+	StringRef SourceBuffer::view(size_t offset, size_t length) const
+	{
+		return StringRef(_data+offset, length);
+	}
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_SOURCE_BUFFER_H
+#define __MITTEN_SOURCE_BUFFER_H
+
+#include <iostream>
+#include <string>
+#include <memory>
+#include <utility>
+
+#include "StringRef.h"
+
+namespace mitten
+{
+	/*! \brief An immutable buffer holding the contents of a source file.
+	 * Source buffers are always handled through reference-counted pointers, so that tokens lexed from a buffer
+	 * can refer to their values inside it rather than copying them. A buffer lives as long as any token does.
+	 * Regular files are memory-mapped read-only; pipes, character devices and standard input are read into
+	 * memory instead. A leading UTF-8 byte order mark in a file is not part of the contents.
+	 */
+	class SourceBuffer
+	{
+	protected:
+		std::string _path; //! The file path of the origin file.
+		std::string _body; //! The contents of the buffer, if it is not memory-mapped.
+		const char *_data; //! The first character of the contents.
+		size_t _size; //! The number of characters in the contents.
+		void *_map; //! The start of the memory mapping, or NULL.
+		size_t _mapSize; //! The length of the memory mapping.
+		bool _bom; //! Whether or not the origin started with a byte order mark.
+
+		/*! \brief Constructor.
+		 * Use fromString or fromFile instead.
+		 */
+		SourceBuffer(std::string p, std::string b);
+
+		/*! \brief Constructor for a memory-mapped buffer.
+		 * Use fromFile instead. The buffer takes ownership of the mapping.
+		 */
+		SourceBuffer(std::string p, void *m, size_t n);
+
+		/*! \brief Skips a leading UTF-8 byte order mark, if there is one. */
+		void skipBOM();
+
+	public:
+		/*! \brief Unmaps the buffer if it is memory-mapped. */
+		~SourceBuffer();
+
+		SourceBuffer(const SourceBuffer &) = delete;
+		SourceBuffer &operator = (const SourceBuffer &) = delete;
+
+		/*! \brief Creates a source buffer holding a string.
+		 * The string is kept as it is, byte order mark included.
+		 * \param b The contents of the buffer.
+		 * \param p The file path to report for the buffer.
+		 */
+		static std::shared_ptr<const SourceBuffer> fromString(std::string b, std::string p = "--");
+
+		/*! \brief Creates a source buffer holding the contents of a file.
+		 * Regular files are memory-mapped, with the kernel advised that they will be read sequentially. Anything
+		 * else, and the path "-" for standard input, is read in full with read(). Throws a runtime_error if the
+		 * file cannot be read.
+		 * \param p The path of the file to be read.
+		 */
+		static std::shared_ptr<const SourceBuffer> fromFile(std::string p);
+
+		/*! \brief Creates a source buffer holding everything that can be read from a file descriptor.
+		 * The descriptor is not closed. Throws a runtime_error on a read error.
+		 * \param fd The file descriptor to read from.
+		 * \param p The file path to report for the buffer.
+		 */
+		static std::shared_ptr<const SourceBuffer> fromDescriptor(int fd, std::string p = "--");
+
+		/*! \brief Gets the size of a file in bytes without reading it.
+		 * \param p The path of the file.
+		 * \returns The size of the file, or -1 if it does not exist or is not a regular file.
+		 */
+		static long fileSize(std::string p);
+
+		/*! \brief Gets the file path of the origin file. */
+		const std::string &path() const;
+
+		/*! \brief Gets a copy of the contents of the buffer. */
+		std::string str() const;
+
+		/*! \brief Gets a pointer to the first character of the buffer. */
+		const char *data() const;
+
+		/*! \brief Gets the size of the buffer in bytes. */
+		size_t size() const;
+
+		/*! \brief Returns true if the buffer is memory-mapped. */
+		bool mapped() const;
+
+		/*! \brief Returns true if the origin started with a UTF-8 byte order mark. */
+		bool hasBOM() const;
+
+		/*! \brief Gets a view of the whole buffer. */
+		StringRef view() const;
+
+		/*! \brief Gets a view of part of the buffer.
+		 * \param offset The offset of the first character.
+		 * \param length The number of characters.
+		 */
+		StringRef view(size_t offset, size_t length) const;
+	};
+}
+
+#endif
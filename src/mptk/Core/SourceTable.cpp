@@ -0,0 +1,350 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "SourceTable.h"
+#include "Utils.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace mitten
+{
+	// The innermost Scope of the current thread, NULL if none.
+	static thread_local SourceTable::Scope *currentScope = NULL;
+
+	SourceTable::Scope::Join::Join(Scope *s) : saved(currentScope)
+	{
+		if (s != NULL)
+			currentScope = s;
+	}
+
+	SourceTable::Scope::Join::~Join()
+	{
+		currentScope = saved;
+	}
+
+	SourceTable::Scope::Scope() : Scope(SourceTable::global())
+	{
+	}
+
+	SourceTable::Scope::Scope(SourceTable &t) : table(t), pool(t.acquirePool()), outer(currentScope)
+	{
+		currentScope = this;
+	}
+
+	SourceTable::Scope::~Scope()
+	{
+		currentScope = outer;
+
+		vector<FileId> added;
+		{
+			lock_guard<std::mutex> lock(table.mutex);
+			added.swap(files);
+		}
+		for (auto i : added)
+			table.remove(i);
+		table.releasePool(pool);
+	}
+
+	SourceTable::Scope *SourceTable::Scope::current()
+	{
+		return currentScope;
+	}
+
+	size_t SourceTable::StringHash::operator () (StringRef s) const
+	{
+		return (size_t)hashBytes(s.data(), s.size());
+	}
+
+	SourceTable::SourceTable() : fileCount(0), poolCount(0)
+	{
+		for (uint32_t i = 0; i < MaxPools; i++)
+			pools[i].store(NULL);
+
+		files.create(AnonymousFile).path = "--";
+		pathIds["--"] = AnonymousFile;
+		fileCount = 1;
+
+		acquirePool();
+		Pool &global = *pools[0].load();
+		global.strings.create(EmptyString).clear();
+		global.ids[StringRef(global.strings[EmptyString])] = EmptyString;
+		global.count = 1;
+	}
+
+	SourceTable::~SourceTable()
+	{
+		for (uint32_t i = 0; i < MaxPools; i++)
+			delete pools[i].load();
+	}
+
+	SourceTable &SourceTable::global()
+	{
+		static SourceTable table;
+		return table;
+	}
+
+	SourceTable::Entry &SourceTable::entry(FileId f) const
+	{
+		Entry &e = files[f & FileIndexMask];
+		if (e.generation.load(memory_order_acquire) != (f >> FileIndexBits))
+			throw runtime_error("file id "+to_string(f)+" refers to a removed source table entry");
+		return e;
+	}
+
+	const LineIndex &SourceTable::buildLines(Entry &e) const
+	{
+		shared_ptr<const LineIndex> l = atomic_load(&e.lines);
+		if (!l)
+		{
+			// Threads racing to build the index build equal ones, and all but the first are dropped.
+			shared_ptr<const SourceBuffer> b = atomic_load(&e.buffer);
+			shared_ptr<const LineIndex> n = (b ? make_shared<const LineIndex>(StringRef(b->data(), b->size())) : make_shared<const LineIndex>());
+			if (atomic_compare_exchange_strong(&e.lines, &l, n))
+				l = n;
+		}
+		return *l;
+	}
+
+	SourceTable::FileId SourceTable::add(shared_ptr<const SourceBuffer> b, int line, int column)
+	{
+		if (b->size() > UINT32_MAX)
+			throw runtime_error("source buffer is too large: "+b->path());
+
+		lock_guard<std::mutex> lock(mutex);
+		uint32_t n;
+		if (freeFiles.size() > ReuseDelay)
+		{
+			n = freeFiles.front();
+			freeFiles.pop_front();
+		}
+		else
+		{
+			n = fileCount;
+			files.create(n);
+			fileCount++;
+		}
+
+		Entry &e = files[n];
+		FileId rtn = n | (e.generation.load(memory_order_relaxed) << FileIndexBits);
+		Scope *s = innermost();
+		if (s != NULL)
+			s->files.push_back(rtn);
+		e.path = b->path();
+		atomic_store(&e.buffer, b);
+		e.data.store(b.get(), memory_order_release);
+		e.line = line;
+		e.column = column;
+		return rtn;
+	}
+
+	SourceTable::FileId SourceTable::addPath(const string &p)
+	{
+		if (p == "--")
+			return AnonymousFile;
+
+		// Tokens which own their values mostly come in runs from the same file.
+		static thread_local const SourceTable *lastTable = NULL;
+		static thread_local string lastPath;
+		static thread_local FileId lastId = AnonymousFile;
+		if (lastTable == this && lastPath == p)
+			return lastId;
+
+		lock_guard<std::mutex> lock(mutex);
+		auto i = pathIds.find(p);
+		if (i != pathIds.end())
+			return i->second;
+
+		FileId rtn = fileCount;
+		files.create(rtn).path = p;
+		pathIds[p] = rtn;
+		fileCount++;
+
+		lastTable = this;
+		lastPath = p;
+		lastId = rtn;
+		return rtn;
+	}
+
+	SourceTable::Scope *SourceTable::innermost() const
+	{
+		for (Scope *i = currentScope; i != NULL; i = i->outer)
+		{
+			if (&(i->table) == this)
+				return i;
+		}
+		return NULL;
+	}
+
+	uint32_t SourceTable::acquirePool()
+	{
+		lock_guard<std::mutex> lock(mutex);
+		if (!freePools.empty())
+		{
+			uint32_t rtn = freePools.back();
+			freePools.pop_back();
+			return rtn;
+		}
+
+		if (poolCount >= MaxPools)
+			throw runtime_error("too many intern scopes");
+		pools[poolCount].store(new Pool(), memory_order_release);
+		return poolCount++;
+	}
+
+	void SourceTable::releasePool(uint32_t p)
+	{
+		Pool &pool = *pools[p].load(memory_order_acquire);
+		{
+			lock_guard<std::mutex> lock(pool.mutex);
+			pool.ids.clear();
+			for (uint32_t i = 0; i < pool.count; i++)
+				string().swap(pool.strings[i]);
+			pool.count = 0;
+		}
+
+		lock_guard<std::mutex> lock(mutex);
+		freePools.push_back(p);
+	}
+
+	uint32_t SourceTable::intern(StringRef s)
+	{
+		if (s.empty())
+			return EmptyString;
+
+		Scope *scope = innermost();
+		uint32_t p = (scope != NULL ? scope->pool : 0);
+
+		Pool &pool = *pools[p].load(memory_order_acquire);
+		lock_guard<std::mutex> lock(pool.mutex);
+		auto i = pool.ids.find(s);
+		if (i != pool.ids.end())
+			return (p << IndexBits) | i->second;
+
+		uint32_t n = pool.count;
+		string &v = pool.strings.create(n);
+		v = s.str();
+		pool.ids[StringRef(v)] = n;
+		pool.count++;
+		return (p << IndexBits) | n;
+	}
+
+	StringRef SourceTable::interned(uint32_t id) const
+	{
+		return StringRef(pools[id >> IndexBits].load(memory_order_acquire)->strings[id & ((1u << IndexBits)-1)]);
+	}
+
+	const std::string &SourceTable::path(FileId f) const
+	{
+		return entry(f).path;
+	}
+
+	void SourceTable::release(FileId f)
+	{
+		Entry &e = entry(f);
+		buildLines(e);
+		e.data.store(NULL, memory_order_release);
+		atomic_store(&e.buffer, shared_ptr<const SourceBuffer>());
+	}
+
+	void SourceTable::remove(FileId f)
+	{
+		lock_guard<std::mutex> lock(mutex);
+		Entry &e = files[f & FileIndexMask];
+		if (e.generation.load(memory_order_relaxed) != (f >> FileIndexBits))
+			return;
+
+		e.data.store(NULL, memory_order_release);
+		atomic_store(&e.buffer, shared_ptr<const SourceBuffer>());
+		atomic_store(&e.lines, shared_ptr<const LineIndex>());
+		e.line = 1;
+		e.column = 0;
+		e.generation.store(((f >> FileIndexBits)+1) & GenerationMask, memory_order_release);
+		freeFiles.push_back(f & FileIndexMask);
+	}
+
+	void SourceTable::origin(FileId f, int &line, int &column) const
+	{
+		Entry &e = entry(f);
+		line = e.line;
+		column = e.column;
+	}
+
+	shared_ptr<const SourceBuffer> SourceTable::buffer(FileId f) const
+	{
+		return atomic_load(&entry(f).buffer);
+	}
+
+	StringRef SourceTable::view(FileId f, uint32_t offset, uint32_t length) const
+	{
+		Entry &e = entry(f);
+		const SourceBuffer *b = e.data.load(memory_order_acquire);
+		if (b == NULL)
+			throw runtime_error("source buffer of "+e.path+" has been released");
+		return b->view(offset, length);
+	}
+
+	void SourceTable::position(FileId f, uint32_t offset, int &line, int &column) const
+	{
+		Entry &e = entry(f);
+		buildLines(e).position(offset, line, column);
+		if (line == 1)
+			column += e.column;
+		line += e.line-1;
+	}
+
+	const LineIndex &SourceTable::lines(FileId f) const
+	{
+		return buildLines(entry(f));
+	}
+
+	bool SourceTable::lineText(FileId f, int line, StringRef &text) const
+	{
+		Entry &e = entry(f);
+		if (e.data.load(memory_order_acquire) == NULL)
+			return false;
+
+		const LineIndex &l = buildLines(e);
+		line -= e.line-1;
+		if (line < 1 || (size_t)line > l.lines())
+			return false;
+
+		text = l.lineText(line);
+		return true;
+	}
+}
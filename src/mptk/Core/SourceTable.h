@@ -0,0 +1,355 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_SOURCE_TABLE_H
+#define __MITTEN_SOURCE_TABLE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <atomic>
+#include <stdexcept>
+#include <mutex>
+#include <stdint.h>
+
+#include "StringRef.h"
+#include "SourceBuffer.h"
+#include "LineIndex.h"
+
+namespace mitten
+{
+	/*! \brief The table of source files and interned strings used by a compilation.
+	 * Tokens refer to their origin file by a 32-bit id into this table instead of carrying the file path and
+	 * the source buffer themselves. Values which do not come from a source buffer (synthesized tokens, macro
+	 * bodies) are interned here as well. A compilation should run within a Scope, which owns the strings
+	 * interned and the files added while it exists and frees them when it ends; outside of any scope they are
+	 * kept for as long as the process runs. Entries can also be removed earlier, and the contents of an entry
+	 * can be released once nothing refers to them anymore. The id of a removed entry is
+	 * eventually reused, but under a new generation, so a token of the removed entry fails loudly instead of
+	 * reading another file's text. There is one table per
+	 * process; it may be read and appended to from several threads, and entries may be released or removed
+	 * while other threads read other entries, but not while tokens of the entry itself are being read.
+	 */
+	class SourceTable
+	{
+	public:
+		typedef uint32_t FileId; //! Identifies a file in the table.
+
+		static const FileId AnonymousFile = 0; //! The id of the anonymous file "--".
+		static const uint32_t EmptyString = 0; //! The id of the interned empty string.
+
+		/*! \brief Owns the strings interned and the files added on the current thread while it exists.
+		 * Meant to span a compilation. Strings go into a pool of the scope's own, and the files are removed
+		 * when the scope ends, so no token created within the scope may be used afterwards: reading one
+		 * which viewed a file throws a runtime_error. Scopes nest, and must end on the thread they began on,
+		 * in reverse order; other threads can work within a scope through a Join.
+		 */
+		class Scope
+		{
+			friend class SourceTable;
+
+		protected:
+			SourceTable &table; //! The table the pool and the files are in.
+			uint32_t pool; //! The index of the pool.
+			Scope *outer; //! The scope this one is nested in, NULL if none.
+			std::vector<FileId> files; //! The files added within the scope; guarded by the table's mutex.
+
+		public:
+			/*! \brief Makes a scope begun on another thread the innermost one of the current thread while it exists.
+			 * The scope must outlive the join.
+			 */
+			class Join
+			{
+			protected:
+				Scope *saved; //! The innermost scope of the thread before the join.
+
+			public:
+				/*! \brief Constructor.
+				 * Joins a scope; does nothing if \p s is NULL.
+				 */
+				explicit Join(Scope *s);
+
+				/*! \brief Destructor.
+				 * Leaves the scope.
+				 */
+				~Join();
+
+				Join(const Join &) = delete;
+				Join &operator = (const Join &) = delete;
+			};
+
+			/*! \brief Constructor.
+			 * Begins a scope in the table of the current process.
+			 */
+			Scope();
+
+			/*! \brief Constructor.
+			 * Begins a scope in a table.
+			 */
+			explicit Scope(SourceTable &t);
+
+			/*! \brief Destructor.
+			 * Ends the scope, freeing its pool and removing its files.
+			 */
+			~Scope();
+
+			Scope(const Scope &) = delete;
+			Scope &operator = (const Scope &) = delete;
+
+			/*! \brief Gets the innermost scope of the current thread, NULL if there is none. */
+			static Scope *current();
+		};
+
+	protected:
+		static const uint32_t SegmentBits = 10; //! Log2 of the number of entries in a segment.
+		static const uint32_t SegmentSize = 1 << SegmentBits; //! The number of entries in a segment.
+		static const uint32_t MaxSegments = 4096; //! The maximum number of segments of file entries.
+		static const uint32_t FileIndexBits = 22; //! Bits of a file id holding the index of its entry; the rest hold the entry's generation.
+		static const uint32_t FileIndexMask = (1u << FileIndexBits)-1; //! Mask of the index of a file id.
+		static const uint32_t GenerationMask = (1u << (32-FileIndexBits))-1; //! Mask of a generation, once shifted down.
+		static const size_t ReuseDelay = 1024; //! The number of removed entries waiting before their ids are reused, so that generations wrap slowly.
+		static_assert((1ULL << FileIndexBits) == (unsigned long long)SegmentSize*MaxSegments, "file ids must be able to index every entry");
+		static const uint32_t PoolBits = 8; //! Bits of a string id holding the index of its pool.
+		static const uint32_t IndexBits = 32-PoolBits; //! Bits of a string id holding its index within the pool.
+		static const uint32_t MaxPools = 1 << PoolBits; //! The maximum number of pools.
+
+		/*! \brief Helper type.
+		 * An array which grows in fixed-size segments, so that elements never move once created and can be
+		 * read without locking while other threads append.
+		 */
+		template <typename T, uint32_t Max = MaxSegments> class Segments
+		{
+		protected:
+			std::atomic<T *> segments[Max]; //! The segments, NULL until first used.
+
+		public:
+			Segments()
+			{
+				for (uint32_t i = 0; i < Max; i++)
+					segments[i].store(NULL);
+			}
+
+			~Segments()
+			{
+				for (uint32_t i = 0; i < Max; i++)
+					delete[] segments[i].load();
+			}
+
+			/*! \brief Gets a reference to the nth element, which must already have been created. */
+			T &operator [] (uint32_t n) const
+			{
+				return segments[n >> SegmentBits].load(std::memory_order_acquire)[n & (SegmentSize-1)];
+			}
+
+			/*! \brief Makes sure the nth element exists and returns a reference to it.
+			 * Must be called with the mutex guarding the array held.
+			 */
+			T &create(uint32_t n)
+			{
+				if ((n >> SegmentBits) >= Max)
+					throw std::runtime_error("source table is full");
+				if (segments[n >> SegmentBits].load(std::memory_order_relaxed) == NULL)
+					segments[n >> SegmentBits].store(new T[SegmentSize], std::memory_order_release);
+				return (*this)[n];
+			}
+		};
+
+		/*! \brief Helper type.
+		 * Describes a file in the table.
+		 */
+		typedef struct Entry
+		{
+			std::string path; //! The file path; only written before the entry is handed out.
+			std::shared_ptr<const SourceBuffer> buffer; //! The contents of the file, NULL if only the path is known; accessed atomically.
+			std::atomic<const SourceBuffer *> data; //! The buffer without its ownership, for reading views without taking a reference.
+			int line; //! The line number of the first character of the buffer.
+			int column; //! The column number of the first character of the buffer.
+			std::shared_ptr<const LineIndex> lines; //! The line index of the buffer, NULL until first used; accessed atomically.
+			std::atomic<uint32_t> generation; //! Incremented whenever the entry is removed; part of the ids of the entry.
+
+			/*! \brief Constructor.
+			 * Initializes an empty entry.
+			 */
+			Entry() : data(NULL), line(1), column(0), generation(0) {}
+		} Entry;
+
+		/*! \brief Helper type.
+		 * Hashes the strings of a pool.
+		 */
+		typedef struct StringHash
+		{
+			size_t operator () (StringRef s) const;
+		} StringHash;
+
+		/*! \brief Helper type.
+		 * A pool of interned strings.
+		 */
+		typedef struct Pool
+		{
+			std::mutex mutex; //! Guards appending to the pool.
+			Segments<std::string, (1 << IndexBits)/SegmentSize> strings; //! The strings, by index.
+			uint32_t count; //! The number of strings.
+			std::unordered_map<StringRef, uint32_t, StringHash> ids; //! Indices of the strings, by value; the keys view the strings themselves.
+
+			/*! \brief Constructor.
+			 * Initializes an empty pool.
+			 */
+			Pool() : count(0) {}
+		} Pool;
+
+		std::mutex mutex; //! Guards appending to the table, and the list of free pools.
+		Segments<Entry> files; //! The file entries, indexed by file id.
+		uint32_t fileCount; //! The number of file entries.
+		std::unordered_map<std::string, FileId> pathIds; //! Ids of path-only entries, by path.
+		std::deque<uint32_t> freeFiles; //! Indices of removed entries, to be reused oldest first.
+		std::atomic<Pool *> pools[MaxPools]; //! The string pools, NULL until first used; pool 0 is used outside of any Scope.
+		uint32_t poolCount; //! The number of pools created.
+		std::vector<uint32_t> freePools; //! Pools which are not in use by any Scope.
+
+		/*! \brief Gets the innermost scope of the current thread in this table, NULL if none. */
+		Scope *innermost() const;
+
+		/*! \brief Gets a pool for a new Scope. */
+		uint32_t acquirePool();
+
+		/*! \brief Frees the strings of a pool and makes it available to later scopes. */
+		void releasePool(uint32_t p);
+
+		/*! \brief Gets the entry of a file id.
+		 * Throws a runtime_error if the entry has been removed since the id was handed out.
+		 */
+		Entry &entry(FileId f) const;
+
+		/*! \brief Builds the line index of an entry if it has not been built yet.
+		 */
+		const LineIndex &buildLines(Entry &e) const;
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes a table containing only the anonymous file "--" as id 0.
+		 */
+		SourceTable();
+
+		/*! \brief Destructor.
+		 */
+		~SourceTable();
+
+		SourceTable(const SourceTable &) = delete;
+		SourceTable &operator = (const SourceTable &) = delete;
+
+		/*! \brief Gets the table used by the current process. */
+		static SourceTable &global();
+
+		/*! \brief Adds a source buffer to the table.
+		 * The entry belongs to the innermost Scope of the current thread, if any, and is removed when it ends.
+		 * Buffers of 4GB or more cannot be added, as offsets into them are 32-bit; a runtime_error is thrown.
+		 * \param b The source buffer.
+		 * \param line The line number of the first character of the buffer (from 1).
+		 * \param column The column number of the first character of the buffer (from 0).
+		 * \returns The id of the new entry.
+		 */
+		FileId add(std::shared_ptr<const SourceBuffer> b, int line = 1, int column = 0);
+
+		/*! \brief Gets the id of an entry with a file path but no contents.
+		 * Used for tokens which own their values. Entries are shared between calls with the same path.
+		 */
+		FileId addPath(const std::string &p);
+
+		/*! \brief Interns a string.
+		 * The string goes into the pool of the innermost Scope of the current thread, or into the global
+		 * pool, which is never freed, if there is none.
+		 * \returns The id of the interned string; equal strings in the same pool get equal ids.
+		 */
+		uint32_t intern(StringRef s);
+
+		/*! \brief Gets an interned string by id. */
+		StringRef interned(uint32_t id) const;
+
+		/*! \brief Gets the file path of an entry. */
+		const std::string &path(FileId f) const;
+
+		/*! \brief Drops the source buffer of an entry.
+		 * Line and column numbers of the entry stay available, but the values of tokens lexed from it do not;
+		 * this must not be called while such tokens are still in use.
+		 */
+		void release(FileId f);
+
+		/*! \brief Removes an entry added with add(), so that its index can be reused by a later entry.
+		 * Unlike release(), line and column numbers of tokens lexed from the entry are lost as well: using
+		 * such tokens afterwards throws a runtime_error, unless about a million more entries have been removed
+		 * since. Removing an entry which was already removed does nothing.
+		 */
+		void remove(FileId f);
+
+		/*! \brief Gets the line and column number the source buffer of an entry starts at.
+		 * Unlike position(), this does not need the line index of the buffer.
+		 */
+		void origin(FileId f, int &line, int &column) const;
+
+		/*! \brief Gets the source buffer of an entry, NULL if it has none. */
+		std::shared_ptr<const SourceBuffer> buffer(FileId f) const;
+
+		/*! \brief Gets a view of part of an entry's source buffer.
+		 * Throws a runtime_error if the buffer has been released.
+		 */
+		StringRef view(FileId f, uint32_t offset, uint32_t length) const;
+
+		/*! \brief Finds the line and column number of an offset into an entry's source buffer.
+		 * \param f The file id.
+		 * \param offset The offset into the buffer.
+		 * \param line Set to the line number (from 1).
+		 * \param column Set to the column number (from 0).
+		 */
+		void position(FileId f, uint32_t offset, int &line, int &column) const;
+
+		/*! \brief Gets the line index of an entry's source buffer, building it on first use. */
+		const LineIndex &lines(FileId f) const;
+
+		/*! \brief Gets the text of a line of an entry's source buffer.
+		 * \param f The file id.
+		 * \param line The line number, as returned by position().
+		 * \param text Set to a view of the line, without its newline.
+		 * \returns False if the entry has no source buffer or no such line.
+		 */
+		bool lineText(FileId f, int line, StringRef &text) const;
+	};
+}
+
+#endif
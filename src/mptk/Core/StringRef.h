@@ -0,0 +1,148 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_STRING_REF_H
+#define __MITTEN_STRING_REF_H
+
+#include <iostream>
+#include <string>
+#include <cstring>
+
+namespace mitten
+{
+	/*! \brief A read-only view of a range of characters.
+	 * StringRef does not own the characters it refers to; whatever does own them (usually a SourceBuffer) must
+	 * outlive the view. It is used to hand token values and source text around without copying them.
+	 */
+	class StringRef
+	{
+	protected:
+		const char *_data; //! The first character of the view.
+		size_t _size; //! The number of characters in the view.
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes an empty view.
+		 */
+		StringRef() : _data(""), _size(0) {}
+
+		/*! \brief Constructor.
+		 * Initializes a view of \p n characters starting at \p d.
+		 */
+		StringRef(const char *d, size_t n) : _data(d), _size(n) {}
+
+		/*! \brief Constructor.
+		 * Initializes a view of the null-terminated string \p s.
+		 */
+		StringRef(const char *s) : _data(s), _size(strlen(s)) {}
+
+		/*! \brief Constructor.
+		 * Initializes a view of the entire string \p s.
+		 */
+		StringRef(const std::string &s) : _data(s.data()), _size(s.size()) {}
+
+		/*! \brief Gets a pointer to the first character of the view. */
+		const char *data() const { return _data; }
+
+		/*! \brief Gets the number of characters in the view. */
+		size_t size() const { return _size; }
+
+		/*! \brief Checks if the view is empty. */
+		bool empty() const { return _size == 0; }
+
+		/*! \brief Gets the nth character of the view. */
+		char operator [] (size_t n) const { return _data[n]; }
+
+		/*! \brief Creates a begin iterator. */
+		const char *begin() const { return _data; }
+
+		/*! \brief Creates an end iterator. */
+		const char *end() const { return _data+_size; }
+
+		/*! \brief Gets a view of part of this view.
+		 * \param pos The position of the first character.
+		 * \param n The maximum number of characters.
+		 */
+		StringRef substr(size_t pos, size_t n = std::string::npos) const
+		{
+			if (pos > _size)
+				pos = _size;
+			if (n > _size-pos)
+				n = _size-pos;
+			return StringRef(_data+pos, n);
+		}
+
+		/*! \brief Copies the view into a new string. */
+		std::string str() const { return std::string(_data, _size); }
+
+		/*! \brief Compares the view with another.
+		 * \returns Zero if equal, otherwise the sign of the first difference, like std::string::compare.
+		 */
+		int compare(StringRef o) const
+		{
+			size_t n = (_size < o._size ? _size : o._size);
+			int r = (n == 0 ? 0 : memcmp(_data, o._data, n));
+			if (r != 0)
+				return r;
+			if (_size == o._size)
+				return 0;
+			return (_size < o._size ? -1 : 1);
+		}
+
+		/*! \brief Checks whether the view starts with \p p. */
+		bool startsWith(StringRef p) const
+		{
+			return (p._size <= _size && memcmp(_data, p._data, p._size) == 0);
+		}
+
+		/*! \brief Checks whether the view ends with \p p. */
+		bool endsWith(StringRef p) const
+		{
+			return (p._size <= _size && memcmp(_data+_size-p._size, p._data, p._size) == 0);
+		}
+
+		bool operator == (StringRef o) const { return (_size == o._size && compare(o) == 0); }
+		bool operator != (StringRef o) const { return !(*this == o); }
+	};
+
+	inline std::ostream &operator << (std::ostream &os, StringRef s)
+	{
+		return os.write(s.data(), s.size());
+	}
+}
+
+#endif
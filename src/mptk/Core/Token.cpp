@@ -38,39 +38,123 @@
 
 namespace mitten
 {
-	int Token::line()
+	static_assert(sizeof(Token) == 16, "tokens are expected to be 16 bytes");
+
+	void Token::own(StringRef v, const std::string &f, int l, int c, TokenTag t, bool fil)
 	{
-		return _line;
+		SourceTable &table = SourceTable::global();
+		_file = table.addPath(f);
+		_offset = table.intern(v);
+		_length = (uint32_t)l;
+		_bits = (uint32_t)t | OwnedBit | (fil ? FilteredBit : 0) | ((uint32_t)c << ExtraShift);
+	}
+
+	int Token::line() const
+	{
+		if (owned())
+			return (int)_length;
+
+		int l, c;
+		SourceTable::global().position(_file, _offset, l, c);
+		return l;
+	}
+
+	int Token::column() const
+	{
+		if (owned())
+			return (int)(_bits >> ExtraShift);
+
+		int l, c;
+		SourceTable::global().position(_file, _offset, l, c);
+		return c;
 	}
 
-	int Token::column()
+	std::string Token::value() const
 	{
-		return _column;
+		return view().str();
 	}
 
-	std::string Token::value()
+	StringRef Token::view() const
 	{
-		return _value;
+		if (owned())
+			return SourceTable::global().interned(_offset);
+		return SourceTable::global().view(_file, _offset, _length);
 	}
 
-	TokenTag Token::tag()
+	bool Token::owned() const
 	{
-		return _tag;
+		return (_bits & OwnedBit) != 0;
 	}
 
-	TokenTag &Token::setTag(TokenTag t)
+	std::shared_ptr<const SourceBuffer> Token::source() const
 	{
-		_tag = t;
-		return _tag;
+		if (owned())
+			return std::shared_ptr<const SourceBuffer>();
+		return SourceTable::global().buffer(_file);
 	}
 
-	std::string Token::file()
+	SourceTable::FileId Token::fileId() const
 	{
 		return _file;
 	}
 
-	bool Token::filtered()
+	size_t Token::offset() const
+	{
+		if (owned())
+			return 0;
+		return _offset;
+	}
+
+	size_t Token::length() const
+	{
+		if (owned())
+			return view().size();
+		return _length;
+	}
+
+	TokenTag Token::tag() const
+	{
+		return (TokenTag)(_bits & TagMask);
+	}
+
+	TokenTag Token::setTag(TokenTag t)
+	{
+		_bits = (_bits & ~TagMask) | (uint32_t)t;
+		return t;
+	}
+
+	uint16_t Token::keyword() const
+	{
+		if (owned())
+			return 0;
+		return (uint16_t)(_bits >> ExtraShift);
+	}
+
+	uint16_t Token::setKeyword(uint16_t k)
+	{
+		if (!owned())
+			_bits = (_bits & ((1u << ExtraShift)-1)) | ((uint32_t)k << ExtraShift);
+		return k;
+	}
+
+	Token Token::rebased(SourceTable::FileId f, long shift) const
+	{
+		Token rtn = *this;
+		if (!owned())
+		{
+			rtn._file = f;
+			rtn._offset = (uint32_t)((long)_offset+shift);
+		}
+		return rtn;
+	}
+
+	std::string Token::file() const
+	{
+		return SourceTable::global().path(_file);
+	}
+
+	bool Token::filtered() const
 	{
-		return _filtered;
+		return (_bits & FilteredBit) != 0;
 	}
 }
@@ -39,6 +39,12 @@
 
 #include <iostream>
 #include <string>
+#include <memory>
+#include <stdint.h>
+
+#include "StringRef.h"
+#include "SourceBuffer.h"
+#include "SourceTable.h"
 
 namespace mitten
 {
@@ -61,65 +67,125 @@ namespace mitten
 	} TokenTag;
 
 	/*! \brief Contains the information required in a simple token.
-	 * \todo Reduce memory footprint.
+	 * Tokens are 16 bytes: the id of the origin file in the SourceTable, the offset and length of the value
+	 * within the file's source buffer, and the tag and flags packed into one word. Line and column numbers are
+	 * derived from the offset on demand. Tokens which own their values (synthesized tokens, macro bodies)
+	 * instead store the id of their interned value, with the line number in place of the length and the column
+	 * number in the spare bits of the packed word; other tokens keep their keyword id there. Offsets are 32-bit,
+	 * so a source buffer tokens are lexed from must be smaller than 4GB.
 	 */
 	class Token
 	{
 	protected:
-		int _line; //! Line number of the first character of the token.
-		int _column; //! Column number of the first character of the token.
-		std::string _value; //! The token's value.
-		TokenTag _tag; //! The token's tag.
-		std::string _file; //! The file path of the origin file.
-		bool _filtered; //! Whether or not the token was filtered by the lexer.
+		static const uint32_t TagMask = 0x07; //! Bits of _bits holding the tag.
+		static const uint32_t FilteredBit = 0x08; //! Bit of _bits set if the token is filtered.
+		static const uint32_t OwnedBit = 0x10; //! Bit of _bits set if the token owns its value.
+		static const uint32_t ExtraShift = 5; //! Shift of the spare bits of _bits.
+
+		SourceTable::FileId _file; //! The id of the origin file.
+		uint32_t _offset; //! Offset of the value within the source buffer, or the interned value id if owned.
+		uint32_t _length; //! Length of the value within the source buffer, or the line number if owned.
+		uint32_t _bits; //! The tag, the flags and, if owned, the column number.
+
+		/*! \brief Helper method to initialize a token which owns its value. */
+		void own(StringRef v, const std::string &f, int l, int c, TokenTag t, bool fil);
 
 	public:
 		/*! \brief Constructor.
 		 * Intializes the line and column number to the beginning of the file.
 		 */
-		Token() : _line(1), _column(0), _file("--") {}
+		Token() : _file(SourceTable::AnonymousFile), _offset(SourceTable::EmptyString), _length(1), _bits((uint32_t)DeliminatorTag | OwnedBit) {}
 
 		/*! \brief Constructor.
 		 * Intializes the line and column number to the beginning of the file.
 		 */
-		Token(std::string v) : _value(v), _line(1), _column(0), _file("--") {}
+		Token(std::string v) { own(v, "--", 1, 0, DeliminatorTag, false); }
 
 		/*! \brief Constructor
-		 * Sets all of the information in the token.
+		 * Sets all of the information in the token, which owns its value.
 		 * \param v The value of the token.
 		 * \param f The origin file path.
 		 * \param l The line number.
 		 * \param c The column number.
 		 * \param t Optional token tag.
 		 */
-		Token(std::string v, std::string f, int l, int c, TokenTag t = DeliminatorTag, bool fil = false) : _line(l), _column(c), _value(v), _tag(t), _file(f), _filtered(fil) {}
+		Token(std::string v, std::string f, int l, int c, TokenTag t = DeliminatorTag, bool fil = false) { own(v, f, l, c, t, fil); }
+
+		/*! \brief Constructor
+		 * Sets all of the information in the token, whose value is a view into a source buffer.
+		 * \param f The id of the origin file, which must have a source buffer.
+		 * \param o The offset of the value within the buffer.
+		 * \param n The length of the value.
+		 * \param t Optional token tag.
+		 * \param k Optional keyword id.
+		 */
+		Token(SourceTable::FileId f, uint32_t o, uint32_t n, TokenTag t = DeliminatorTag, bool fil = false, uint16_t k = 0) : 
+			_file(f), _offset(o), _length(n), _bits((uint32_t)t | (fil ? FilteredBit : 0) | ((uint32_t)k << ExtraShift)) {}
 
 		/*! \brief Gets the line number of the first character of the token. 
 		 * Starts from 1.
 		 */
-		int line();
+		int line() const;
 
 		/*! \brief Gets the column number of the first character of the token.
 		 * Starts from 0.
 		 */
-		int column();
+		int column() const;
 
 		/*! \brief Gets the value of the token. */
-		std::string value();
+		std::string value() const;
+
+		/*! \brief Gets a view of the value of the token.
+		 * The view is valid for the rest of the compilation.
+		 */
+		StringRef view() const;
+
+		/*! \brief Checks if the token owns its value, rather than viewing a source buffer. */
+		bool owned() const;
+
+		/*! \brief Gets the source buffer the token was lexed from, NULL if the value is owned. */
+		std::shared_ptr<const SourceBuffer> source() const;
+
+		/*! \brief Gets the id of the origin file in the SourceTable. */
+		SourceTable::FileId fileId() const;
+
+		/*! \brief Gets the offset of the token within its source buffer, 0 if the value is owned. */
+		size_t offset() const;
+
+		/*! \brief Gets the length of the token's value. */
+		size_t length() const;
 
 		/*! \brief Gets the tag of the token. */
-		TokenTag tag();
+		TokenTag tag() const;
 
 		/*! \brief Assigns the tag of the token.
 		 * Used mostly by the tagger in the Lexer class.
 		 */
-		TokenTag &setTag(TokenTag t);
+		TokenTag setTag(TokenTag t);
+
+		/*! \brief Gets the keyword id the lexer gave the token.
+		 * Keyword ids index the KeywordTable of the lexer, from 1; tokens which are not keywords, and tokens
+		 * which own their values, have id 0.
+		 */
+		uint16_t keyword() const;
+
+		/*! \brief Assigns the keyword id of the token.
+		 * Ignored for tokens which own their values.
+		 */
+		uint16_t setKeyword(uint16_t k);
+
+		/*! \brief Gets a copy of the token moved into another source buffer.
+		 * Used when re-lexing an edited buffer. Tokens which own their values are copied unchanged.
+		 * \param f The id of the new origin file.
+		 * \param shift The distance the value moved by.
+		 */
+		Token rebased(SourceTable::FileId f, long shift) const;
 
 		/*! \brief Gets the file path of the origin file. */
-		std::string file();
+		std::string file() const;
 
 		/*! \brief Gets whether or not the token is filtered. */
-		bool filtered();
+		bool filtered() const;
 	};
 }
 
@@ -35,6 +35,12 @@
  */
 
 #include "Utils.h"
+#include "SourceBuffer.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MITTEN_X86_SIMD
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
@@ -61,9 +67,8 @@ namespace mitten
 
 	string readFile8(string path)
 	{
-		ifstream f(path.c_str());
-		string rtn((istreambuf_iterator<char>(f)), istreambuf_iterator<char>());
-		return rtn;
+		shared_ptr<const SourceBuffer> b = SourceBuffer::fromFile(path);
+		return (b->hasBOM() ? string("\xEF\xBB\xBF")+b->str() : b->str());
 	}
 
 	string evaluateEscapeCodes(string s)
@@ -175,4 +180,297 @@ namespace mitten
 
 		return rtn;
 	}
+
+	static const char *findBytesScalar(const char *b, const char *e, const char *p, size_t n)
+	{
+		const char *last = e-n;
+		for (const char *c = b; c <= last; c++)
+		{
+			c = (const char *)memchr(c, p[0], last-c+1);
+			if (c == NULL)
+				return NULL;
+			if (memcmp(c+1, p+1, n-1) == 0)
+				return c;
+		}
+
+		return NULL;
+	}
+
+#ifdef MITTEN_X86_SIMD
+	__attribute__((target("sse2")))
+	static const char *findBytesSSE2(const char *b, const char *e, const char *p, size_t n)
+	{
+		const __m128i first = _mm_set1_epi8(p[0]);
+		const __m128i last = _mm_set1_epi8(p[n-1]);
+		const char *c = b;
+
+		for (; c+n-1+16 <= e; c += 16)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)c);
+			__m128i y = _mm_loadu_si128((const __m128i *)(c+n-1));
+			unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(x, first), _mm_cmpeq_epi8(y, last)));
+			while (mask != 0)
+			{
+				const char *k = c+__builtin_ctz(mask);
+				if (memcmp(k, p, n) == 0)
+					return k;
+				mask &= mask-1;
+			}
+		}
+
+		return findBytesScalar(c, e, p, n);
+	}
+
+	__attribute__((target("avx2")))
+	static const char *findBytesAVX2(const char *b, const char *e, const char *p, size_t n)
+	{
+		const __m256i first = _mm256_set1_epi8(p[0]);
+		const __m256i last = _mm256_set1_epi8(p[n-1]);
+		const char *c = b;
+
+		for (; c+n-1+32 <= e; c += 32)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i *)c);
+			__m256i y = _mm256_loadu_si256((const __m256i *)(c+n-1));
+			unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(x, first), _mm256_cmpeq_epi8(y, last)));
+			while (mask != 0)
+			{
+				const char *k = c+__builtin_ctz(mask);
+				if (memcmp(k, p, n) == 0)
+					return k;
+				mask &= mask-1;
+			}
+		}
+
+		return findBytesSSE2(c, e, p, n);
+	}
+#endif
+
+	const char *findBytes(const char *b, const char *e, const char *p, size_t n)
+	{
+		if (n == 0)
+			return b;
+		if (e < b || (size_t)(e-b) < n)
+			return NULL;
+		if (n == 1)
+			return (const char *)memchr(b, p[0], e-b);
+
+#ifdef MITTEN_X86_SIMD
+		static const bool avx2 = __builtin_cpu_supports("avx2");
+		if (avx2)
+			return findBytesAVX2(b, e, p, n);
+		return findBytesSSE2(b, e, p, n);
+#else
+		return findBytesScalar(b, e, p, n);
+#endif
+	}
+
+	static size_t countBytesScalar(const char *b, const char *e, char c)
+	{
+		size_t rtn = 0;
+		for (; b < e; b++)
+			rtn += (*b == c);
+		return rtn;
+	}
+
+#ifdef MITTEN_X86_SIMD
+	__attribute__((target("sse2,popcnt")))
+	static size_t countBytesSSE2(const char *b, const char *e, char c)
+	{
+		const __m128i v = _mm_set1_epi8(c);
+		size_t rtn = 0;
+		for (; b+16 <= e; b += 16)
+			rtn += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)b), v)));
+		return rtn+countBytesScalar(b, e, c);
+	}
+
+	__attribute__((target("avx2,popcnt")))
+	static size_t countBytesAVX2(const char *b, const char *e, char c)
+	{
+		const __m256i v = _mm256_set1_epi8(c);
+		size_t rtn = 0;
+		for (; b+32 <= e; b += 32)
+			rtn += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)b), v)));
+		return rtn+countBytesScalar(b, e, c);
+	}
+#endif
+
+	size_t countBytes(const char *b, const char *e, char c)
+	{
+#ifdef MITTEN_X86_SIMD
+		static const bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+		static const bool popcnt = __builtin_cpu_supports("popcnt");
+		if (avx2)
+			return countBytesAVX2(b, e, c);
+		if (popcnt)
+			return countBytesSSE2(b, e, c);
+#endif
+		return countBytesScalar(b, e, c);
+	}
+
+	static inline uint64_t hashMix(uint64_t h)
+	{
+		h ^= h >> 33;
+		h *= 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 33;
+		h *= 0xC4CEB9FE1A85EC53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+
+	uint64_t hashBytes(const char *b, size_t n, uint64_t seed)
+	{
+		uint64_t rtn = seed ^ (n*0x9E3779B97F4A7C15ULL);
+		size_t i = 0;
+		for (; i+8 <= n; i += 8)
+		{
+			uint64_t w;
+			memcpy(&w, b+i, 8);
+			rtn = (rtn ^ hashMix(w))*0x9E3779B97F4A7C15ULL;
+			rtn = (rtn << 29) | (rtn >> 35);
+		}
+
+		if (i < n)
+		{
+			uint64_t w = 0;
+			memcpy(&w, b+i, n-i);
+			rtn = (rtn ^ hashMix(w))*0x9E3779B97F4A7C15ULL;
+		}
+
+		return hashMix(rtn);
+	}
+
+	ByteSet::ByteSet() : exact(true)
+	{
+		for (int i = 0; i < 4; i++)
+			bits[i] = 0;
+		rebuild();
+	}
+
+	void ByteSet::insert(unsigned char c)
+	{
+		bits[c >> 6] |= 1ULL << (c & 63);
+		rebuild();
+	}
+
+	void ByteSet::rebuild()
+	{
+		// Group the high nibbles by the set of low nibbles they accept; each group gets one of 8 buckets.
+		uint16_t patterns[8];
+		int buckets = 0;
+		exact = true;
+		for (int i = 0; i < 16; i++)
+		{
+			lowTable[i] = 0;
+			highTable[i] = 0;
+		}
+
+		for (int h = 0; h < 16; h++)
+		{
+			uint16_t pattern = 0;
+			for (int l = 0; l < 16; l++)
+			{
+				if (contains((unsigned char)(h << 4 | l)))
+					pattern |= 1 << l;
+			}
+			if (pattern == 0)
+				continue;
+
+			int k = 0;
+			while (k < buckets && patterns[k] != pattern)
+				k++;
+			if (k == buckets)
+			{
+				if (buckets < 8)
+				{
+					patterns[buckets++] = pattern;
+				}
+				else
+				{
+					k = 7;
+					patterns[7] |= pattern;
+					exact = false;
+				}
+			}
+			highTable[h] |= 1 << k;
+		}
+
+		for (int k = 0; k < buckets; k++)
+		{
+			for (int l = 0; l < 16; l++)
+			{
+				if (patterns[k] & (1 << l))
+					lowTable[l] |= 1 << k;
+			}
+		}
+	}
+
+#ifdef MITTEN_X86_SIMD
+	__attribute__((target("ssse3")))
+	static const char *findByteSetSSSE3(const char *b, const char *e, const unsigned char *low, const unsigned char *high)
+	{
+		const __m128i lowTable = _mm_loadu_si128((const __m128i *)low);
+		const __m128i highTable = _mm_loadu_si128((const __m128i *)high);
+		const __m128i nibble = _mm_set1_epi8(0x0F);
+		const __m128i zero = _mm_setzero_si128();
+
+		for (; b+16 <= e; b += 16)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)b);
+			__m128i l = _mm_shuffle_epi8(lowTable, _mm_and_si128(x, nibble));
+			__m128i h = _mm_shuffle_epi8(highTable, _mm_and_si128(_mm_srli_epi16(x, 4), nibble));
+			unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(l, h), zero)) ^ 0xFFFF;
+			if (mask != 0)
+				return b+__builtin_ctz(mask);
+		}
+		return b;
+	}
+
+	__attribute__((target("avx2")))
+	static const char *findByteSetAVX2(const char *b, const char *e, const unsigned char *low, const unsigned char *high)
+	{
+		const __m256i lowTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)low));
+		const __m256i highTable = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)high));
+		const __m256i nibble = _mm256_set1_epi8(0x0F);
+		const __m256i zero = _mm256_setzero_si256();
+
+		for (; b+32 <= e; b += 32)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i *)b);
+			__m256i l = _mm256_shuffle_epi8(lowTable, _mm256_and_si256(x, nibble));
+			__m256i h = _mm256_shuffle_epi8(highTable, _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble));
+			unsigned mask = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(l, h), zero));
+			if (mask != 0)
+				return b+__builtin_ctz(mask);
+		}
+		return findByteSetSSSE3(b, e, low, high);
+	}
+#endif
+
+	const char *ByteSet::find(const char *b, const char *e) const
+	{
+		while (b < e)
+		{
+#ifdef MITTEN_X86_SIMD
+			static const bool avx2 = __builtin_cpu_supports("avx2");
+			static const bool ssse3 = __builtin_cpu_supports("ssse3");
+			if (avx2)
+				b = findByteSetAVX2(b, e, lowTable, highTable);
+			else if (ssse3)
+				b = findByteSetSSSE3(b, e, lowTable, highTable);
+#endif
+			// Either a candidate from the tables or the tail which is too short for a vector.
+			for (; b < e; b++)
+			{
+				if (contains((unsigned char)*b))
+					return b;
+				if (!exact)
+				{
+					b++;
+					break;
+				}
+			}
+		}
+		return e;
+	}
 }
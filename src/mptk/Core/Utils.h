@@ -42,14 +42,16 @@
 #include <streambuf>
 #include <fstream>
 #include <stdexcept>
+#include <string.h>
+#include <stdint.h>
 
 //#include "AbstractWidthString.h"
 
 namespace mitten
 {
 	/*! \brief Reads a file into a string.
-	 * Loads the entire contents of a file into a dynamically-expanding string object.
-	 * If readFile is unable to open the file, it will throw a runtime_error.
+	 * Loads the entire contents of a file into a string, by way of SourceBuffer::fromFile. Unlike the buffer,
+	 * the string keeps a leading UTF-8 byte order mark. Prefer using a SourceBuffer directly, which avoids the copy. If readFile is unable to open the file, it will throw a runtime_error.
 	 * \param path The path of the file to be read.
 	 * \param width The character width of the file's encoding.
 	 * \returns The contents of the file.
@@ -57,8 +59,8 @@ namespace mitten
 	//AbstractWidthString readFile(std::string path, size_t width = 8);
 
 	/*! \brief Reads a file into a string.
-	 * Loads the entire contents of a file into a dynamically-expanding string object.
-	 * If readFile is unable to open the file, it will throw a runtime_error.
+	 * Loads the entire contents of a file into a string, by way of SourceBuffer::fromFile. Unlike the buffer,
+	 * the string keeps a leading UTF-8 byte order mark. Prefer using a SourceBuffer directly, which avoids the copy. If readFile is unable to open the file, it will throw a runtime_error.
 	 * \param path The path of the file to be read.
 	 * \param width The character width of the file's encoding.
 	 * \returns The contents of the file.
@@ -70,6 +72,74 @@ namespace mitten
  	 * \returns Evaluated string.
  	 */
 	std::string evaluateEscapeCodes(std::string s);
+
+	/*! \brief Finds the first occurrence of a byte string in a range.
+	 * Candidates are found 16 or 32 bytes at a time by comparing the first and last bytes of the
+	 * pattern with SSE2 or AVX2, whichever the processor supports, and then verified; other
+	 * targets use memchr.
+	 * \param b The start of the range.
+	 * \param e The end of the range.
+	 * \param p The pattern.
+	 * \param n The length of the pattern.
+	 * \returns A pointer to the first occurrence in the range, or NULL if there is none.
+	 */
+	const char *findBytes(const char *b, const char *e, const char *p, size_t n);
+
+	/*! \brief Counts the occurrences of a byte in a range.
+	 * Compares 32 or 16 bytes at a time with AVX2 or SSE2, whichever the processor supports.
+	 * \param b The start of the range.
+	 * \param e The end of the range.
+	 * \param c The byte to count.
+	 * \returns The number of occurrences.
+	 */
+	size_t countBytes(const char *b, const char *e, char c);
+
+	/*! \brief Hashes a range of bytes.
+	 * Mixes in 8 bytes at a time, so that whole source files can be hashed quickly. The hash is the same
+	 * across runs and processes, and is meant for content addressing rather than for security.
+	 * \param b The start of the range.
+	 * \param n The number of bytes.
+	 * \param seed A value to start from, used to chain hashes.
+	 * \returns The hash of the range.
+	 */
+	uint64_t hashBytes(const char *b, size_t n, uint64_t seed = 0);
+
+	/*! \brief A set of bytes which can be searched for quickly.
+	 * Besides a bitmap, the set is kept as a pair of 16-entry nibble tables, so that 16 or 32 bytes at a
+	 * time can be tested for membership with SSSE3 or AVX2 shuffles, whichever the processor supports.
+	 * Sets needing more than eight distinct low-nibble patterns are approximated by the tables, and
+	 * candidates are then confirmed against the bitmap.
+	 */
+	class ByteSet
+	{
+	protected:
+		uint64_t bits[4]; //! Bit c is set if byte c is in the set.
+		unsigned char lowTable[16]; //! The buckets accepting each low nibble.
+		unsigned char highTable[16]; //! The buckets accepting each high nibble.
+		bool exact; //! Whether the nibble tables match no bytes outside the set.
+
+		/*! \brief Rebuilds the nibble tables from the bitmap. */
+		void rebuild();
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes an empty set.
+		 */
+		ByteSet();
+
+		/*! \brief Adds a byte to the set. */
+		void insert(unsigned char c);
+
+		/*! \brief Checks whether a byte is in the set. */
+		bool contains(unsigned char c) const { return (bits[c >> 6] >> (c & 63)) & 1; }
+
+		/*! \brief Finds the first byte in a range which is in the set.
+		 * \param b The start of the range.
+		 * \param e The end of the range.
+		 * \returns A pointer to the byte found, or \p e if there is none.
+		 */
+		const char *find(const char *b, const char *e) const;
+	};
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,239 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "CompiledGrammar.h"
+#include "Lexer.h"
+
+using namespace std;
+
+namespace mitten
+{
+	CompiledGrammar::StringConstPattern::StringConstPattern(std::string v)
+	{
+		value = v;
+		for (auto i : v)
+		{
+			if (i == '\n')
+			{
+				linediff++;
+				coldiff = 0;
+			}
+			else
+			{
+				coldiff++;
+			}
+		}
+	}
+
+	CompiledGrammar::CompiledGrammar(const Lexer &l) : maxDelimLength(l.maxDelimLength), keywords(l.keywords), macros(l.lexicalMacros), callbacks(false)
+	{
+		for (auto &i : l.delims)
+		{
+			for (auto &j : i.second)
+			{
+				delims.push_back(j.second);
+				delimKeywords.push_back(keywords.find(j.second.start.value));
+				if (j.second.patternCallback)
+					callbacks = true;
+			}
+		}
+		compileTrie();
+		classifier.update(l.symbolTag, l.boolTag, l.charTag, l.stringTag, l.floatTag);
+
+		hash = TokenClassifier::fingerprint(l.symbolTag, l.boolTag, l.charTag, l.stringTag, l.floatTag)^keywords.fingerprint();
+		for (auto &d : delims)
+		{
+			uint64_t h = hashBytes(d.start.value.data(), d.start.value.size(), (uint64_t)d.flags*2+(d.patternCallback ? 1 : 0));
+			hash += hashBytes(d.end.value.data(), d.end.value.size(), h);
+		}
+		hash = hashBytes(NULL, 0, hash ^ macros.fingerprint());
+	}
+
+	void CompiledGrammar::compileTrie()
+	{
+		for (int i = 0; i < 256; i++)
+			trieClasses[i] = 0;
+
+		trieClassCount = 1;
+		for (auto &i : delims)
+		{
+			for (auto c : i.start.value)
+			{
+				if (trieClasses[(unsigned char)c] == 0)
+					trieClasses[(unsigned char)c] = trieClassCount++;
+			}
+		}
+
+		trieNext.assign(trieClassCount, 0);
+		trieAccept.assign(1, NULL);
+
+		for (auto &i : delims)
+		{
+			firstBytes.insert((unsigned char)i.start.value[0]);
+
+			int n = 0;
+			for (auto c : i.start.value)
+			{
+				size_t k = n*trieClassCount+trieClasses[(unsigned char)c];
+				if (trieNext[k] == 0)
+				{
+					trieNext[k] = trieAccept.size();
+					trieNext.resize(trieNext.size()+trieClassCount, 0);
+					trieAccept.push_back(NULL);
+				}
+				n = trieNext[k];
+			}
+
+			trieAccept[n] = &i;
+		}
+	}
+
+	const CompiledGrammar::Deliminator *CompiledGrammar::matchDeliminator(StringRef s, size_t i, size_t &length, bool &exhausted, size_t limit) const
+	{
+		const Deliminator *rtn = NULL;
+		int n = 0;
+
+		exhausted = false;
+		for (size_t j = i; j < s.size(); j++)
+		{
+			if (j-i >= limit)
+				return rtn;
+
+			n = trieNext[n*trieClassCount+trieClasses[(unsigned char)s[j]]];
+			if (n == 0)
+				return rtn;
+
+			if (trieAccept[n] != NULL)
+			{
+				rtn = trieAccept[n];
+				length = j-i+1;
+			}
+		}
+
+		exhausted = (i < s.size());
+		return rtn;
+	}
+
+	const CompiledGrammar::Deliminator *CompiledGrammar::findDeliminator(StringRef start) const
+	{
+		size_t l = 0;
+		bool exhausted;
+		const Deliminator *d = matchDeliminator(start, 0, l, exhausted);
+		return (d != NULL && l == start.size() ? d : NULL);
+	}
+
+	TokenTag CompiledGrammar::classify(StringRef s) const
+	{
+		return classifier.classify(s);
+	}
+
+	const KeywordTable &CompiledGrammar::keywordTable() const
+	{
+		return keywords;
+	}
+
+	MacroTable::Body CompiledGrammar::findMacro(StringRef name) const
+	{
+		return macros.find(name);
+	}
+
+	size_t CompiledGrammar::maxDeliminatorLength() const
+	{
+		return maxDelimLength;
+	}
+
+	bool CompiledGrammar::hasPatternCallbacks() const
+	{
+		return callbacks;
+	}
+
+	uint64_t CompiledGrammar::fingerprint() const
+	{
+		return hash;
+	}
+
+	bool CompiledGrammar::isSyncPoint(const std::vector<Token> &v, size_t j, StringRef s, SourceTable::FileId f) const
+	{
+		size_t l = 0;
+		bool exhausted;
+
+		if (v[j].owned() || v[j].fileId() != f)
+			return false;
+
+		// An undelimited token always follows a deliminator.
+		size_t o = v[j].offset();
+		if (o == 0 || matchDeliminator(s, o, l, exhausted) == NULL)
+			return true;
+
+		return (j > 0 && !v[j-1].owned() && v[j-1].fileId() == f && v[j-1].offset()+v[j-1].length() == o && 
+			matchDeliminator(s, v[j-1].offset(), l, exhausted) != NULL);
+	}
+
+	size_t CompiledGrammar::lexSpans(StringRef s, TokenSpan *out, size_t capacity, bool skipFiltered, size_t *stop) const
+	{
+		if (capacity < 2)
+		{
+			if (stop != NULL)
+				*stop = 0;
+			return 0;
+		}
+
+		size_t n = 0;
+		size_t until = string::npos;
+		size_t end = scanRaw(s, 0, until, true, [&](size_t o, size_t l, TokenTag t, bool filtered, const Deliminator *, KeywordId k)
+		{
+			if (filtered && skipFiltered)
+				return;
+
+			out[n++] = TokenSpan((uint32_t)o, (uint32_t)l, t, filtered, k);
+			// An undelimited token and a deliminator can be found in one step, so stop while there is room for both.
+			if (capacity-n < 2)
+				until = 0;
+		});
+
+		if (stop != NULL)
+			*stop = end;
+		return n;
+	}
+
+	void CompiledGrammar::lexSpans(StringRef s, vector<TokenSpan> &out, bool skipFiltered) const
+	{
+		lexSpans(s, 0, skipFiltered, [&out](const TokenSpan &t)
+		{
+			out.push_back(t);
+		});
+	}
+}
@@ -0,0 +1,464 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MITTEN_COMPILED_GRAMMAR_H
+#define __MITTEN_COMPILED_GRAMMAR_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <functional>
+#include <algorithm>
+
+#include "../Core/Token.h"
+#include "../Core/Utils.h"
+#include "Latin/TokenClassifier.h"
+#include "MacroTable.h"
+#include "KeywordTable.h"
+
+namespace mitten
+{
+	/*! \brief Bitwise flags for deliminator declarations.
+	 * The lexer uses these flags to configure how the tokens are added to the resultant token vector.
+	 */
+	typedef enum
+	{
+		Defaults = 0x00, //! No special flags.
+		Filtered = 0x01, //! Removes the token from the token vector resultant from lexing.
+	} DeliminatorFlags;
+
+	/*! \brief The bounds and tag of a token, without its value or origin.
+	 * Produced by CompiledGrammar::lexSpans; offsets are into the string lexed.
+	 */
+	typedef struct TokenSpan
+	{
+		uint32_t offset; //! The offset of the token.
+		uint32_t length; //! The length of the token.
+		uint8_t tag; //! The TokenTag of the token.
+		bool filtered; //! Whether the token is a filtered deliminator.
+		KeywordId keyword; //! The keyword id of the token, NoKeyword if none.
+
+		/*! \brief Constructor.
+		 * Initializes an empty span.
+		 */
+		TokenSpan() : offset(0), length(0), tag(DeliminatorTag), filtered(false), keyword(NoKeyword) {}
+
+		/*! \brief Constructor.
+		 * \param o The offset of the token.
+		 * \param n The length of the token.
+		 * \param t The tag of the token.
+		 * \param fil Whether the token is a filtered deliminator.
+		 * \param k The keyword id of the token.
+		 */
+		TokenSpan(uint32_t o, uint32_t n, TokenTag t, bool fil, KeywordId k) : offset(o), length(n), tag((uint8_t)t), filtered(fil), keyword(k) {}
+	} TokenSpan;
+
+	class Lexer;
+
+	/*! \brief A lexical grammar compiled for lexing.
+	 * Holds a snapshot of a Lexer's deliminators, tagger settings and lexical macros, together with the
+	 * tables built from them: the deliminator trie and the tag classifier. A compiled grammar never changes
+	 * once built, so any number of threads may lex against one shared instance at the same time; per-lex
+	 * state lives in LexerState. Get one from Lexer::compile.
+	 */
+	class CompiledGrammar
+	{
+	public:
+		/*! \brief Helper type.
+		 * Used to store deliminator start/end-points. It contains not only the
+		 * string pattern itself, but the line/column difference across the
+		 * string.
+		 */
+		typedef struct StringConstPattern
+		{
+			std::string value; //! String value.
+			int linediff, coldiff; //! Line/column difference across the string.
+
+			/*! \brief Constructor.
+			 * Initializes empty pattern.
+			 */
+			StringConstPattern() : linediff(0), coldiff(0) {}
+
+			/*! \brief Constructor.
+			 * Initializes pattern with string value.
+			 * \param v String value.
+			 */
+			StringConstPattern(std::string v);
+		} StringConstPattern;
+
+		/*! \brief Callback to be used for deliminator end-points.
+		 * Called wherever the deliminator's start point is found, with a view of the input from there on
+		 * (as much of it as is available) and the offset of the start point in the input. Any callable
+		 * will do, including lambdas with captures; since a compiled grammar may be shared by several
+		 * threads, callbacks which carry state must be safe to call concurrently.
+		 * \param s The input, starting at the start point.
+		 * \param from The offset of the start point in the input.
+		 * \returns The length of the resultant deliminator, at least that of the start point, or NoMatch to
+		 * let the lexer try shorter deliminators at the same position instead. When lexing a stream, either a
+		 * length reaching the end of \p s or NoMatch makes the lexer wait for more input and call again with it;
+		 * only once the input has ended does a length reaching its end mean the deliminator runs to the end.
+		 */
+		typedef std::function<size_t (StringRef s, size_t from)> DeliminatorPatternCallback;
+
+		static const size_t NoMatch = 0; //! Returned by a pattern callback which does not match.
+
+		/*! \brief Helper type.
+		 * Stores deliminator descriptions.
+		 */
+		typedef struct Deliminator
+		{
+			StringConstPattern start; //! Start point.
+			StringConstPattern end; //! End point.
+			DeliminatorFlags flags; //! Description flags.
+			DeliminatorPatternCallback patternCallback; //! A callback that can be used in leiu of the end point.
+
+			/*! \brief Constructor.
+			 * Initiates empty deliminator.
+			 */
+			Deliminator() : flags(Defaults) {}
+
+			/*! \brief Constructor.
+			 * Creates deliminator with start but no end point.
+			 * \param p Start point.
+			 */
+			Deliminator(StringConstPattern p) : start(p), flags(Defaults) {}
+
+			/*! \brief Constructor.
+			 * Creates deliminator with start and an end point specified by a callback.
+			 * \param p Start point.
+			 * \param c Pattern callback.
+			 */
+			Deliminator(StringConstPattern p, DeliminatorPatternCallback c) : start(p), flags(Defaults), patternCallback(c) {}
+
+			/*! \brief Constructor.
+			 * Creates deliminator with start and end points.
+			 * \param p Start point.
+			 * \param e End point.
+			 */
+			Deliminator(StringConstPattern s, StringConstPattern e) : 
+				start(s), end(e), flags(Defaults) {}
+		} Deliminator;
+
+		/*! \brief Helper type.
+		 * The end-point a scan of a prefix of the input stopped to wait for. Until the end-point turns up in
+		 * more input, scanning again would stop at the same place, so a caller reading the input in chunks
+		 * can skip rescanning until then.
+		 */
+		typedef struct PendingEnd
+		{
+			const std::string *end; //! The end-point, NULL if the scan did not stop inside a deliminator.
+			size_t from; //! The offset from which the end-point has yet to be searched for.
+
+			/*! \brief Constructor.
+			 * Initializes a scan which waits for nothing.
+			 */
+			PendingEnd() : end(NULL), from(0) {}
+		} PendingEnd;
+
+	protected:
+		std::vector<Deliminator> delims; //! The deliminators; the trie points into this vector.
+		size_t maxDelimLength; //! The length of the longest deliminator start-point.
+
+		/*! \brief Maps every byte to its class in the deliminator trie.
+		 * Bytes which do not appear in any deliminator start-point are mapped to class 0, which has no transitions.
+		 */
+		unsigned char trieClasses[256];
+
+		/*! \brief The number of byte classes in the deliminator trie.
+		 */
+		size_t trieClassCount;
+
+		/*! \brief The transition table of the deliminator trie.
+		 * Indexed by node*trieClassCount+class. Node 0 is the root, so a transition to 0 means there is no transition.
+		 */
+		std::vector<int> trieNext;
+
+		/*! \brief The deliminator accepted at each trie node, NULL if none.
+		 */
+		std::vector<const Deliminator *> trieAccept;
+
+		/*! \brief The bytes deliminator start-points begin with.
+		 * Runs of other bytes are skipped over without walking the trie.
+		 */
+		ByteSet firstBytes;
+
+		TokenClassifier classifier; //! The taggers fused into one classifier.
+		KeywordTable keywords; //! The keywords.
+		std::vector<KeywordId> delimKeywords; //! The keyword id of each deliminator's start-point, by index in delims.
+		MacroTable macros; //! The lexical macros.
+		uint64_t hash; //! The fingerprint of the grammar.
+		bool callbacks; //! Whether any deliminator has a pattern callback.
+
+		/*! \brief Compiles the deliminators into the deliminator trie.
+		 */
+		void compileTrie();
+
+	public:
+		/*! \brief Constructor.
+		 * Compiles the current grammar of a lexer.
+		 */
+		CompiledGrammar(const Lexer &l);
+
+		CompiledGrammar(const CompiledGrammar &) = delete;
+		CompiledGrammar &operator = (const CompiledGrammar &) = delete;
+
+		/*! \brief Finds the longest deliminator starting at a position.
+		 * Walks the deliminator trie forward from \p i without allocating.
+		 * \param s The input string.
+		 * \param i The position to match at.
+		 * \param length Set to the length of the start-point matched, if any.
+		 * \param exhausted Set if the walk ran into the end of \p s while a longer start-point could still match.
+		 * \param limit The length of the longest start-point to consider.
+		 * \returns The deliminator matched, or NULL if none starts at \p i.
+		 */
+		const Deliminator *matchDeliminator(StringRef s, size_t i, size_t &length, bool &exhausted, size_t limit = std::string::npos) const;
+
+		/*! \brief Finds the deliminator with a start-point.
+		 * \returns The deliminator, NULL if none starts with exactly \p start.
+		 */
+		const Deliminator *findDeliminator(StringRef start) const;
+
+		/*! \brief Finds the tag of a token value. */
+		TokenTag classify(StringRef s) const;
+
+		/*! \brief Gets the keywords tokens are given ids from. */
+		const KeywordTable &keywordTable() const;
+
+		/*! \brief Looks up a lexical macro.
+		 * \returns The body of the macro, NULL if it is not defined.
+		 */
+		MacroTable::Body findMacro(StringRef name) const;
+
+		/*! \brief Gets the length of the longest deliminator start-point. */
+		size_t maxDeliminatorLength() const;
+
+		/*! \brief Checks whether any deliminator has a pattern callback.
+		 * Callbacks may look ahead as far as they like, so a token can depend on any text after it.
+		 */
+		bool hasPatternCallbacks() const;
+
+		/*! \brief Hashes the grammar.
+		 * Covers the deliminators, the tagger settings, the keywords and the lexical macros: two grammars with the same
+		 * fingerprint lex any input to the same tokens. Pattern callbacks are identified only by their
+		 * start points, so that only holds for grammars without them; see hasPatternCallbacks().
+		 */
+		uint64_t fingerprint() const;
+
+		/*! \brief Lexes part of a string, handing each token to a sink as it is found.
+		 * Lexing starts at \p from as though a token begins there. Macros are not expanded.
+		 * \param s The input string.
+		 * \param f The file id of \p s in the source table.
+		 * \param from The offset to start at.
+		 * \param until Lexing stops at the end of the first deliminator reaching this offset.
+		 * \param final Whether \p s runs up to the end of the input.
+		 * \param sink Called with each token and whether it is a deliminator.
+		 * \param pending If not NULL, set to the end-point the scan stopped to wait for, if any.
+		 * \returns The offset up to which \p s was lexed.
+		 */
+		template <typename Sink> size_t scanSpan(StringRef s, SourceTable::FileId f, size_t from, size_t until, bool final, Sink sink, PendingEnd *pending = NULL) const;
+
+		/*! \brief Lexes part of a string, handing each token's bounds, tag and filtered flag to a sink.
+		 * The core of scanSpan; no tokens are created, and \p s need not be in the source table. The sink
+		 * may lower \p until to stop lexing early.
+		 * \param sink Called with the offset, length, tag and filtered flag of each token, the deliminator it
+		 * matched (NULL if none) and its keyword id.
+		 */
+		template <typename Sink> size_t scanRaw(StringRef s, size_t from, const size_t &until, bool final, Sink sink, PendingEnd *pending = NULL) const;
+
+		/*! \brief Lexes a string into token spans.
+		 * Uses the same deliminators and taggers as lexing into tokens, but does not expand macros, and
+		 * neither copies values nor allocates per token: meant for tools such as highlighters and indexers
+		 * which only need to know where tokens are.
+		 * \param s The input string.
+		 * \param out The array to write spans to.
+		 * \param capacity The number of spans \p out has room for; at least 2.
+		 * \param skipFiltered Whether to leave out filtered deliminators.
+		 * \param stop If not NULL, set to the offset up to which \p s was lexed; if \p out filled up before
+		 * the end of \p s, lexing can be resumed from there.
+		 * \returns The number of spans written.
+		 */
+		size_t lexSpans(StringRef s, TokenSpan *out, size_t capacity, bool skipFiltered = false, size_t *stop = NULL) const;
+
+		/*! \brief Lexes a string into token spans, appending them to a vector.
+		 * The vector is reused as is, so lexing many strings into the same vector allocates only while it grows.
+		 * \param s The input string.
+		 * \param out The vector to append to.
+		 * \param skipFiltered Whether to leave out filtered deliminators.
+		 */
+		void lexSpans(StringRef s, std::vector<TokenSpan> &out, bool skipFiltered = false) const;
+
+		/*! \brief Lexes a string into token spans, handing each to a sink chosen at compile time.
+		 * \param s The input string.
+		 * \param from The offset to start at.
+		 * \param skipFiltered Whether to leave out filtered deliminators.
+		 * \param sink Called with each TokenSpan.
+		 * \returns The length of \p s.
+		 */
+		template <typename Sink> size_t lexSpans(StringRef s, size_t from, bool skipFiltered, Sink sink) const;
+
+		/*! \brief Checks whether the lexer had no token pending at the start of a token lexed earlier.
+		 * \param v The tokens lexed from \p s, possibly along with tokens from other files.
+		 * \param j The index of the token in \p v.
+		 * \param s The string \p v was lexed from.
+		 * \param f The file id of \p s; tokens from other files are never sync points.
+		 */
+		bool isSyncPoint(const std::vector<Token> &v, size_t j, StringRef s, SourceTable::FileId f) const;
+	};
+
+	template <typename Sink> size_t CompiledGrammar::scanRaw(StringRef s, size_t from, const size_t &until, bool final, Sink sink, PendingEnd *pending) const
+	{
+		size_t last = from;
+		if (pending != NULL)
+			pending->end = NULL;
+
+		for (size_t i = from; i < s.size(); i++)
+		{
+			if (!firstBytes.contains((unsigned char)s[i]))
+			{
+				i = firstBytes.find(s.data()+i, s.end())-s.data();
+				if (i >= s.size())
+					break;
+			}
+
+			size_t j = 0;
+			bool exhausted;
+			const Deliminator *m = matchDeliminator(s, i, j, exhausted);
+
+			if (exhausted && !final)
+				return last;
+
+			size_t dl = j;
+			while (m != NULL && m->patternCallback)
+			{
+				dl = m->patternCallback(s.substr(i), i);
+				if (dl != NoMatch)
+					break;
+
+				// The callback may match once more of the input is seen.
+				if (!final)
+					return last;
+
+				// Fall back to the longest deliminator shorter than the one which did not match.
+				bool ignored;
+				m = (j > 1 ? matchDeliminator(s, i, j, ignored, j-1) : NULL);
+				dl = j;
+			}
+
+			if (m != NULL)
+			{
+				const Deliminator &d = *m;
+				if (!d.end.value.empty())
+				{
+					const char *e = findBytes(s.data()+i+dl, s.data()+s.size(), d.end.value.data(), d.end.value.size());
+					if (e != NULL)
+					{
+						dl = e-(s.data()+i)+d.end.value.size();
+					}
+					else
+					{
+						if (!final)
+						{
+							if (pending != NULL)
+							{
+								// The end-point may straddle the end of s.
+								pending->end = &d.end.value;
+								pending->from = s.size()-std::min(s.size()-(i+dl), d.end.value.size()-1);
+							}
+							return last;
+						}
+						dl = s.size()-i;
+					}
+				}
+				else if (d.patternCallback)
+				{
+					if (dl < j)
+						dl = j;
+					if (dl >= s.size()-i)
+					{
+						if (!final)
+							return last;
+						dl = s.size()-i;
+					}
+				}
+
+				if (last < i)
+				{
+					StringRef v = s.substr(last, i-last);
+					sink(last, i-last, classifier.classify(v), false, (const Deliminator *)NULL, keywords.find(v));
+				}
+
+				KeywordId k = (d.end.value.empty() && !d.patternCallback ? delimKeywords[m-delims.data()] : keywords.find(s.substr(i, dl)));
+				sink(i, dl, DeliminatorTag, (d.flags & Filtered) != 0, m, k);
+
+				i += dl-1;
+				last = i+1;
+				if (last >= until)
+					return last;
+			}
+		}
+
+		if (!final)
+			return last;
+
+		if (last < s.size())
+		{
+			StringRef v = s.substr(last);
+			sink(last, s.size()-last, classifier.classify(v), false, (const Deliminator *)NULL, keywords.find(v));
+		}
+
+		return s.size();
+	}
+
+	template <typename Sink> size_t CompiledGrammar::scanSpan(StringRef s, SourceTable::FileId f, size_t from, size_t until, bool final, Sink sink, PendingEnd *pending) const
+	{
+		return scanRaw(s, from, until, final, [&sink, f](size_t o, size_t n, TokenTag t, bool filtered, const Deliminator *d, KeywordId k)
+		{
+			sink(Token(f, o, n, t, filtered, k), d != NULL);
+		}, pending);
+	}
+
+	template <typename Sink> size_t CompiledGrammar::lexSpans(StringRef s, size_t from, bool skipFiltered, Sink sink) const
+	{
+		return scanRaw(s, from, std::string::npos, true, [&sink, skipFiltered](size_t o, size_t n, TokenTag t, bool filtered, const Deliminator *, KeywordId k)
+		{
+			if (!filtered || !skipFiltered)
+				sink(TokenSpan((uint32_t)o, (uint32_t)n, t, filtered, k));
+		});
+	}
+}
+
+#endif
@@ -0,0 +1,183 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "KeywordTable.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace mitten
+{
+	KeywordTable::KeywordTable() : lengths(0), displacements(1, 0), slots(1, NoKeyword), seed(0), built(true)
+	{
+	}
+
+	KeywordTable::KeywordTable(initializer_list<string> k) : lengths(0), displacements(1, 0), slots(1, NoKeyword), seed(0), built(true)
+	{
+		for (auto &i : k)
+			add(i);
+	}
+
+	KeywordTable::KeywordTable(const KeywordTable &k) : lengths(0), seed(0), built(false)
+	{
+		*this = k;
+	}
+
+	KeywordTable &KeywordTable::operator = (const KeywordTable &k)
+	{
+		if (this == &k)
+			return *this;
+
+		lock_guard<mutex> lock(k.buildLock);
+		names = k.names;
+		ids = k.ids;
+		lengths = k.lengths;
+		displacements = k.displacements;
+		slots = k.slots;
+		seed = k.seed;
+		built.store(k.built.load(memory_order_relaxed), memory_order_release);
+		return *this;
+	}
+
+	void KeywordTable::build() const
+	{
+		// A bucket which finds no displacement within this many is given up on, and the keywords are rehashed.
+		static const uint32_t MaxDisplacement = 4096;
+
+		lock_guard<mutex> lock(buildLock);
+		if (built.load(memory_order_relaxed))
+			return;
+
+		size_t bucketCount = 1;
+		while (bucketCount*4 < names.size())
+			bucketCount *= 2;
+		size_t size = 1;
+		while (size < names.size()+names.size()/4)
+			size *= 2;
+
+		vector<uint64_t> hashes(names.size());
+		vector<vector<KeywordId> > buckets;
+		vector<size_t> order(bucketCount);
+		vector<uint64_t> placed;
+		for (uint64_t attempt = 1;; attempt++)
+		{
+			if (attempt%8 == 0)
+				size *= 2;
+
+			seed = hashBytes(NULL, 0, attempt);
+			buckets.assign(bucketCount, vector<KeywordId>());
+			for (size_t i = 0; i < names.size(); i++)
+			{
+				hashes[i] = hashBytes(names[i].data(), names[i].size(), seed);
+				buckets[hashes[i] & (bucketCount-1)].push_back((KeywordId)(i+1));
+			}
+
+			// The largest buckets are placed first, while most slots are still free.
+			for (size_t b = 0; b < bucketCount; b++)
+				order[b] = b;
+			sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+			displacements.assign(bucketCount, 0);
+			slots.assign(size, NoKeyword);
+			bool clear = true;
+			for (size_t b = 0; clear && b < bucketCount && !buckets[order[b]].empty(); b++)
+			{
+				const vector<KeywordId> &members = buckets[order[b]];
+				clear = false;
+				for (uint32_t d = 0; !clear && d < MaxDisplacement; d++)
+				{
+					placed.clear();
+					clear = true;
+					for (size_t m = 0; clear && m < members.size(); m++)
+					{
+						uint64_t s = displace(hashes[members[m]-1], d) & (size-1);
+						clear = (slots[s] == NoKeyword && std::find(placed.begin(), placed.end(), s) == placed.end());
+						placed.push_back(s);
+					}
+
+					if (clear)
+					{
+						displacements[order[b]] = d;
+						for (size_t m = 0; m < members.size(); m++)
+							slots[placed[m]] = members[m];
+					}
+				}
+			}
+
+			if (clear)
+				break;
+		}
+
+		built.store(true, memory_order_release);
+	}
+
+	KeywordId KeywordTable::add(string k)
+	{
+		auto i = ids.find(k);
+		if (i != ids.end())
+			return i->second;
+		if (names.size() >= 0xFFFF)
+			throw runtime_error("too many keywords");
+
+		names.push_back(k);
+		KeywordId rtn = (KeywordId)names.size();
+		ids.insert(make_pair(k, rtn));
+		lengths |= 1ULL << (k.size() < 63 ? k.size() : 63);
+		built.store(false, memory_order_relaxed);
+		return rtn;
+	}
+
+	const string &KeywordTable::name(KeywordId k) const
+	{
+		if (k == NoKeyword || k > names.size())
+			throw runtime_error("no keyword with id "+to_string(k));
+		return names[k-1];
+	}
+
+	size_t KeywordTable::size() const
+	{
+		return names.size();
+	}
+
+	uint64_t KeywordTable::fingerprint() const
+	{
+		uint64_t rtn = names.size();
+		for (auto &i : names)
+			rtn = hashBytes(i.data(), i.size(), rtn);
+		return rtn;
+	}
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MITTEN_KEYWORD_TABLE_H
+#define __MITTEN_KEYWORD_TABLE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+#include <initializer_list>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "../Core/StringRef.h"
+#include "../Core/Utils.h"
+
+namespace mitten
+{
+	typedef uint16_t KeywordId; //! Identifies a keyword; ids are handed out from 1 in the order keywords are added.
+	static const KeywordId NoKeyword = 0; //! The keyword id of a token which is not a keyword.
+
+	/*! \brief A set of keywords compiled into a perfect hash.
+	 * Every token lexed is looked up here, so lookups are kept cheap: names are filtered by length first,
+	 * and otherwise hashed into a table with no collisions, so at most one name is compared. The hash is
+	 * built by hash-and-displace: keywords are hashed into buckets of a few each, and every bucket gets a
+	 * displacement which moves its keywords to free slots, so the table takes space linear in the number
+	 * of keywords. It is built on the first lookup after keywords were added. Lookups may run on several
+	 * threads at once, but not while keywords are added.
+	 */
+	class KeywordTable
+	{
+	protected:
+		std::vector<std::string> names; //! The keywords; the name of id i is at i-1.
+		std::unordered_map<std::string, KeywordId> ids; //! The id of each keyword, to find duplicates as they are added.
+		uint64_t lengths; //! Bit n is set if a keyword is n bytes long, bit 63 if a keyword is longer.
+
+		mutable std::vector<uint32_t> displacements; //! The displacement of each bucket; the number of buckets is a power of two.
+		mutable std::vector<KeywordId> slots; //! The hash table, NoKeyword where empty; its size is a power of two.
+		mutable uint64_t seed; //! The seed keywords are hashed with.
+		mutable std::atomic<bool> built; //! Whether the hash covers every keyword.
+		mutable std::mutex buildLock; //! Held while the hash is built.
+
+		/*! \brief Finds the slot of a hash in a bucket with a displacement. */
+		static uint64_t displace(uint64_t h, uint32_t d)
+		{
+			h ^= (uint64_t)d*0x9E3779B97F4A7C15ULL;
+			h ^= h >> 33;
+			h *= 0xFF51AFD7ED558CCDULL;
+			return h ^ (h >> 33);
+		}
+
+		/*! \brief Builds the hash, unless another thread has just done so. */
+		void build() const;
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes an empty table.
+		 */
+		KeywordTable();
+
+		/*! \brief Constructor.
+		 * Initializes a table with keywords, numbered from 1 in the order given.
+		 */
+		KeywordTable(std::initializer_list<std::string> k);
+
+		/*! \brief Copy constructor. */
+		KeywordTable(const KeywordTable &k);
+
+		/*! \brief Copy assignment operator. */
+		KeywordTable &operator = (const KeywordTable &k);
+
+		/*! \brief Adds a keyword.
+		 * \returns The id of the keyword; the existing one if it was already added.
+		 */
+		KeywordId add(std::string k);
+
+		/*! \brief Looks up a keyword.
+		 * \returns The id of the keyword, NoKeyword if \p s is not one.
+		 */
+		KeywordId find(StringRef s) const
+		{
+			if ((lengths & (1ULL << (s.size() < 63 ? s.size() : 63))) == 0)
+				return NoKeyword;
+			if (!built.load(std::memory_order_acquire))
+				build();
+			uint64_t h = hashBytes(s.data(), s.size(), seed);
+			KeywordId k = slots[displace(h, displacements[h & (displacements.size()-1)]) & (slots.size()-1)];
+			return (k != NoKeyword && s == StringRef(names[k-1]) ? k : NoKeyword);
+		}
+
+		/*! \brief Gets the name of a keyword.
+		 * Throws a runtime_error if \p k is not the id of a keyword.
+		 */
+		const std::string &name(KeywordId k) const;
+
+		/*! \brief Gets the number of keywords. */
+		size_t size() const;
+
+		/*! \brief Hashes the keywords and their ids. */
+		uint64_t fingerprint() const;
+	};
+}
+
+#endif
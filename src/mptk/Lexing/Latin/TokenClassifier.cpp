@@ -0,0 +1,168 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "TokenClassifier.h"
+
+#include <ctype.h>
+
+#include "../../Core/Utils.h"
+
+using namespace std;
+
+namespace mitten
+{
+	bool TokenClassifier::isQuoted(StringRef s, const string &in, const string &un)
+	{
+		if (!s.startsWith(in))
+			return false;
+
+		// s.rfind(un) == s.size()-un.size() also holds when un is one byte longer than s.
+		return s.endsWith(un) || un.size() == s.size()+1;
+	}
+
+	bool TokenClassifier::isInteger(StringRef s) const
+	{
+		if (s.empty())
+			return false;
+
+		// Values with an 'h' suffix are read as hexadecimal with a "0x" prefix, which always parses.
+		if (s[s.size()-1] == 'h' && (classes[(unsigned char)s[0]] & HexDigitClass))
+			return true;
+
+		if (s == "0x")
+			return false;
+
+		size_t i = 0;
+		while (i < s.size() && (classes[(unsigned char)s[i]] & SpaceClass))
+			i++;
+		if (i < s.size() && (classes[(unsigned char)s[i]] & SignClass))
+			i++;
+
+		return i < s.size() && (classes[(unsigned char)s[i]] & DigitClass);
+	}
+
+	uint64_t TokenClassifier::fingerprint(const SymbolTagger &sym, const BooleanLiteralTagger &b, const CharacterLiteralTagger &c, const StringLiteralTagger &str, const FloatingLiteralTagger &f)
+	{
+		uint64_t rtn = 0;
+		for (auto i : {&sym.allowedChars, &sym.allowedFirstChars, &b.trueToken, &b.falseToken, &c.inQuote, &c.unQuote, &str.inQuote, &str.unQuote})
+			rtn = hashBytes(i->data(), i->size(), rtn);
+		return rtn ^ (c.allowEscapes ? 1 : 0) ^ (f.allowScientific ? 2 : 0);
+	}
+
+	bool TokenClassifier::update(const SymbolTagger &sym, const BooleanLiteralTagger &b, const CharacterLiteralTagger &c, const StringLiteralTagger &str, const FloatingLiteralTagger &f)
+	{
+		if (built &&
+			symbolTag.allowedChars == sym.allowedChars && symbolTag.allowedFirstChars == sym.allowedFirstChars &&
+			boolTag.trueToken == b.trueToken && boolTag.falseToken == b.falseToken &&
+			charTag.allowEscapes == c.allowEscapes && charTag.inQuote == c.inQuote && charTag.unQuote == c.unQuote &&
+			stringTag.inQuote == str.inQuote && stringTag.unQuote == str.unQuote &&
+			floatTag.allowScientific == f.allowScientific)
+			return false;
+
+		symbolTag = sym;
+		boolTag = b;
+		charTag = c;
+		stringTag = str;
+		floatTag = f;
+
+		for (int i = 0; i < 256; i++)
+		{
+			classes[i] = 0;
+			if (isdigit(i))
+				classes[i] |= DigitClass;
+			if (isxdigit(i))
+				classes[i] |= HexDigitClass;
+			if (isspace(i))
+				classes[i] |= SpaceClass;
+		}
+		classes[(unsigned char)'+'] |= SignClass;
+		classes[(unsigned char)'-'] |= SignClass;
+
+		for (auto i : symbolTag.allowedFirstChars)
+			classes[(unsigned char)i] |= SymbolFirstClass;
+		for (auto i : symbolTag.allowedChars)
+			classes[(unsigned char)i] |= SymbolClass;
+
+		built = true;
+		return true;
+	}
+
+	TokenTag TokenClassifier::classify(StringRef s) const
+	{
+		bool symbol = (!s.empty() && (classes[(unsigned char)s[0]] & SymbolFirstClass));
+		bool floating = true;
+		bool gotDot = false;
+
+		for (size_t i = 0; i < s.size() && (symbol || floating); i++)
+		{
+			unsigned char c = classes[(unsigned char)s[i]];
+			if (i > 0 && !(c & SymbolClass))
+				symbol = false;
+
+			if (!floating || (c & DigitClass))
+				continue;
+			else if (s[i] == '-')
+				floating = (i == 0);
+			else if (s[i] == '.')
+			{
+				floating = !gotDot;
+				gotDot = true;
+			}
+			else if (s[i] == 'e' && i != 0 && i != s.size()-1)
+				floating = floatTag.allowScientific;
+			else
+				floating = false;
+		}
+
+		if (symbol)
+			return SymbolTag;
+		else if (s == boolTag.trueToken || s == boolTag.falseToken)
+			return BooleanLiteralTag;
+		else if (isQuoted(s, charTag.inQuote, charTag.unQuote) &&
+			(s.size() == 1+charTag.inQuote.size()+charTag.unQuote.size() ||
+			(s.size() > 1+charTag.inQuote.size()+charTag.unQuote.size() && charTag.allowEscapes)))
+			return CharacterLiteralTag;
+		else if (isQuoted(s, stringTag.inQuote, stringTag.unQuote))
+			return StringLiteralTag;
+		else if (isInteger(s))
+			return IntegerLiteralTag;
+		else if (floating)
+			return FloatingLiteralTag;
+		else
+			return DeliminatorTag;
+	}
+}
@@ -0,0 +1,118 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_TOKEN_CLASSIFIER_H
+#define __MITTEN_TOKEN_CLASSIFIER_H
+
+#include <iostream>
+#include <string>
+
+#include "../../Core/Token.h"
+#include "BooleanLiteralTagger.h"
+#include "CharacterLiteralTagger.h"
+#include "FloatingLiteralTagger.h"
+#include "IntegerLiteralTagger.h"
+#include "StringLiteralTagger.h"
+#include "SymbolTagger.h"
+
+namespace mitten
+{
+	/*! \brief Tags tokens in a single pass.
+	 * Fuses the symbol, boolean, character, string, integer and floating taggers into a per-byte
+	 * class table built from their configuration, so that a token is classified without copying it
+	 * and without rescanning it once per tagger. The result is the same as trying the taggers in the
+	 * order listed above, except that integers too large for an int are tagged as integers instead
+	 * of making IntegerLiteralTagger throw out_of_range.
+	 */
+	class TokenClassifier
+	{
+	protected:
+		/*! \brief Bits of the byte class table.
+		 */
+		typedef enum
+		{
+			SymbolFirstClass = 0x01, //! Allowed as the first character of a symbol.
+			SymbolClass = 0x02, //! Allowed in the rest of a symbol.
+			DigitClass = 0x04, //! A decimal digit.
+			HexDigitClass = 0x08, //! A hexadecimal digit.
+			SpaceClass = 0x10, //! Whitespace, which may lead an integer.
+			SignClass = 0x20 //! A sign, which may lead an integer.
+		} ByteClass;
+
+		unsigned char classes[256]; //! The class bits of each byte.
+		bool built; //! Whether the table has been built.
+
+		SymbolTagger symbolTag; //! The symbol configuration the table was built from.
+		BooleanLiteralTagger boolTag; //! The boolean configuration the table was built from.
+		CharacterLiteralTagger charTag; //! The character configuration the table was built from.
+		StringLiteralTagger stringTag; //! The string configuration the table was built from.
+		FloatingLiteralTagger floatTag; //! The floating configuration the table was built from.
+
+		/*! \brief Checks whether a string is enclosed in a pair of quotes, the way the literal taggers do.
+		 */
+		static bool isQuoted(StringRef s, const std::string &in, const std::string &un);
+
+		/*! \brief Checks whether a string is accepted by IntegerLiteralTagger.
+		 */
+		bool isInteger(StringRef s) const;
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes a classifier which has not been built yet.
+		 */
+		TokenClassifier() : built(false) {}
+
+		/*! \brief Rebuilds the classifier if the tagger configuration differs from the one it was built from.
+		 * The integer tagger has no settings which affect tagging, so it is not needed.
+		 * \returns True if the classifier was rebuilt.
+		 */
+		bool update(const SymbolTagger &sym, const BooleanLiteralTagger &b, const CharacterLiteralTagger &c, const StringLiteralTagger &str, const FloatingLiteralTagger &f);
+
+		/*! \brief Hashes the parts of a tagger configuration which affect tagging.
+		 * Two configurations with the same fingerprint tag every token the same way.
+		 */
+		static uint64_t fingerprint(const SymbolTagger &sym, const BooleanLiteralTagger &b, const CharacterLiteralTagger &c, const StringLiteralTagger &str, const FloatingLiteralTagger &f);
+
+		/*! \brief Finds the tag of a token value.
+		 * \param s The token value.
+		 * \returns The tag, DeliminatorTag if no tagger accepts the value.
+		 */
+		TokenTag classify(StringRef s) const;
+	};
+}
+
+#endif
@@ -40,41 +40,6 @@ using namespace std;
 
 namespace mitten
 {
-	Lexer::StringConstPattern::StringConstPattern(std::string v)
-	{
-		value = v;
-		for (auto i : v)
-		{
-			if (i == '\n')
-			{
-				linediff++;
-				coldiff = 0;
-			}
-			else
-			{
-				coldiff++;
-			}
-		}
-	}
-
-	TokenTag Lexer::findTag(Token t)
-	{
-		if (symbolTag.isSymbol(t))
-			return SymbolTag;
-		else if (boolTag.isBooleanLiteral(t))
-			return BooleanLiteralTag;
-		else if (charTag.isCharacterLiteral(t))
-			return CharacterLiteralTag;
-		else if (stringTag.isStringLiteral(t))
-			return StringLiteralTag;
-		else if (intTag.isIntegerLiteral(t))
-			return IntegerLiteralTag;
-		else if (floatTag.isFloatingLiteral(t))
-			return FloatingLiteralTag;
-		else
-			return DeliminatorTag;
-	}
-
 	DeliminatorFlags &Lexer::deliminate(std::string s, std::string e)
 	{
 		if (s.empty())
@@ -87,6 +52,7 @@ namespace mitten
 				StringConstPattern(e));
 		if (s.size() > maxDelimLength)
 			maxDelimLength = s.size();
+		compiled.reset();
 
 		return delims[s.size()][s].flags;
 	}
@@ -99,6 +65,7 @@ namespace mitten
 		delims[s.size()][s] = Deliminator(StringConstPattern(s), c);
 		if (s.size() > maxDelimLength)
 			maxDelimLength = s.size();
+		compiled.reset();
 
 		return delims[s.size()][s].flags;
 	}
@@ -117,200 +84,94 @@ namespace mitten
 		delims[s.size()].erase(s);
 		if (delims[s.size()].empty() && s.size() == maxDelimLength)
 		{
-			while (delims[maxDelimLength].empty() && maxDelimLength >= 0)
+			while (maxDelimLength > 0 && delims[maxDelimLength].empty())
 			{
 				maxDelimLength--;
 			}
 		}
+		compiled.reset();
 	}
 	
 	void Lexer::defineMacro(string s, vector<Token> v)
 	{
-		lexicalMacros[s] = v;
+		lexicalMacros.define(s, v);
+		compiled.reset();
 	}
 	
 	void Lexer::undefineMacro(string s)
 	{
-		lexicalMacros.erase(s);
+		lexicalMacros.undefine(s);
+		compiled.reset();
 	}
 	
 	bool Lexer::isMacroDefined(string s)
 	{
-		return (lexicalMacros.find(s) != lexicalMacros.end());
+		return (bool)lexicalMacros.find(s);
 	}
 
 	std::vector<Token> Lexer::lex(std::string s, string f, ErrorHandler &eh, int lineoff, int columnoff)
 	{
-		std::vector<Token> rtn;
-
-		int line = 1;
-		if (lineoff > 1)
-			line = lineoff;
-		int column = 0;
-		if (column > 0)
-			column = columnoff;
-		int lastline = 1;
-		int lastcolumn = 0;
-		bool found = false;
-		size_t last = 0;
+		return lex(SourceBuffer::fromString(s, f), eh, lineoff, columnoff);
+	}
 
-		for (size_t i = 0; i < s.size(); i++)
-		{
-			found = false;
+	KeywordId Lexer::keyword(string s)
+	{
+		KeywordId rtn = keywords.add(s);
+		compiled.reset();
+		return rtn;
+	}
 
-			for (size_t j = maxDelimLength; j > 0; j--)
-			{
-				if (delims.find(j) != delims.end())
-				{
-					if (delims[j].find(s.substr(i, j)) != delims[j].end())
-					{
-						Deliminator d = delims[j][s.substr(i, j)];
-						if (last < i)
-						{
-							Token tmp = Token(s.substr(last, i-last), f, lastline, lastcolumn);
-							tmp.setTag(findTag(tmp));
-							if (lexicalMacros.find(tmp.value()) != lexicalMacros.end())
-							{
-								for (auto k : lexicalMacros[tmp.value()])
-								{
-									if (onToken)
-										onToken(k, rtn, eh);
-									else
-										rtn.push_back(k);
-								}
-							}
-							else
-							{
-								if (onToken)
-									onToken(tmp, rtn, eh);
-								else
-									rtn.push_back(tmp);
-							}
-						}
+	const KeywordTable &Lexer::keywordTable() const
+	{
+		return keywords;
+	}
 
-						size_t dl = j;
-						if (!d.end.value.empty())
-						{
-							while (dl+i < s.size())
-							{
-								if (s.substr(i+dl, 
-									d.end.value.size()).compare(d.end.value) 
-									== 0)
-								{
-									dl += d.end.value.size();
-									break;
-								}
+	shared_ptr<const CompiledGrammar> Lexer::compile()
+	{
+		uint64_t taggers = TokenClassifier::fingerprint(symbolTag, boolTag, charTag, stringTag, floatTag);
+		if (!compiled || taggers != compiledTaggers)
+		{
+			compiled = make_shared<const CompiledGrammar>(*this);
+			compiledTaggers = taggers;
+		}
+		return compiled;
+	}
 
-								dl++;
-							}
-						}
-						else if (d.patternCallback != NULL)
-						{
-							dl = d.patternCallback(i, s);
-						}
+	LexerState Lexer::state()
+	{
+		LexerState rtn(compile());
+		rtn.onToken = onToken;
+		rtn.minParallelChunk = minParallelChunk;
+		return rtn;
+	}
 
-						if (!(d.flags & Filtered))
-						{
-							Token tmp = Token(s.substr(i, dl), f, line, column, DeliminatorTag);
-							if (lexicalMacros.find(tmp.value()) != lexicalMacros.end())
-							{
-								for (auto k : lexicalMacros[tmp.value()])
-								{
-									if (onToken)
-										onToken(k, rtn, eh);
-									else
-										rtn.push_back(k);
-								}
-							}
-							else
-							{
-								if (onToken)
-									onToken(tmp, rtn, eh);
-								else
-									rtn.push_back(tmp);
-							}
-						}
-						else
-						{
-							Token tmp = Token(s.substr(i, dl), f, line, column, DeliminatorTag, true);
-							if (lexicalMacros.find(tmp.value()) != lexicalMacros.end())
-							{
-								for (auto k : lexicalMacros[tmp.value()])
-								{
-									if (onToken)
-										onToken(k, rtn, eh);
-									else
-										rtn.push_back(k);
-								}
-							}
-							else
-							{
-								if (onToken)
-									onToken(tmp, rtn, eh);
-								else
-									rtn.push_back(tmp);
-							}
-						}
+	uint64_t Lexer::fingerprint()
+	{
+		return compile()->fingerprint();
+	}
 
-						for (auto c : s.substr(i, dl))
-						{
-							if (c == '\n')
-							{
-								line++;
-								column = 0;
-							}
-							else
-							{
-								column++;
-							}
-						}
+	bool Lexer::hasCallbacks()
+	{
+		return (onToken != nullptr || compile()->hasPatternCallbacks());
+	}
 
-						lastline = line;
-						lastcolumn = column;
-						i += dl-1;
-						last = i+1;
-						found = true;
-					}
-				}
-			}
+	std::vector<Token> Lexer::lex(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff, int columnoff)
+	{
+		return state().lex(b, eh, lineoff, columnoff);
+	}
 
-			if (!found)
-			{
-				if (s[i] == '\n')
-				{
-					line++;
-					column = 0;
-				}
-				else
-				{
-					column++;
-				}
-			}
-		}
+	void Lexer::lex(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, TokenSink &sink, int lineoff, int columnoff)
+	{
+		state().lex(b, eh, sink, lineoff, columnoff);
+	}
 
-		if (last < s.size())
-		{
-			Token tmp = Token(s.substr(last), f, lastline, lastcolumn);
-			tmp.setTag(findTag(tmp));
-			if (lexicalMacros.find(tmp.value()) != lexicalMacros.end())
-			{
-				for (auto k : lexicalMacros[tmp.value()])
-				{
-					if (onToken)
-						onToken(k, rtn, eh);
-					else
-						rtn.push_back(k);
-				}
-			}
-			else
-			{
-				if (onToken)
-					onToken(tmp, rtn, eh);
-				else
-					rtn.push_back(tmp);
-			}
-		}
+	std::vector<Token> Lexer::lexParallel(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, unsigned threads, int lineoff, int columnoff)
+	{
+		return state().lexParallel(b, eh, threads, lineoff, columnoff);
+	}
 
-		return rtn;
+	std::vector<Token> Lexer::relex(const std::vector<Token> &previous, Edit e, shared_ptr<const SourceBuffer> b, ErrorHandler &eh, size_t &changedBegin, size_t &changedEnd)
+	{
+		return state().relex(previous, e, b, eh, changedBegin, changedEnd);
 	}
 }
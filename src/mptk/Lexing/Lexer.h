@@ -44,96 +44,34 @@
 #include <functional>
 
 #include "../Core/Token.h"
+#include "../Core/SourceBuffer.h"
 #include "../Core/ErrorHandler.h"
+#include "../Core/Utils.h"
 #include "Latin/BooleanLiteralTagger.h"
 #include "Latin/CharacterLiteralTagger.h"
 #include "Latin/FloatingLiteralTagger.h"
 #include "Latin/IntegerLiteralTagger.h"
 #include "Latin/StringLiteralTagger.h"
 #include "Latin/SymbolTagger.h"
+#include "Latin/TokenClassifier.h"
+#include "MacroTable.h"
+#include "KeywordTable.h"
+#include "TokenSink.h"
+#include "CompiledGrammar.h"
+#include "LexerState.h"
 
 namespace mitten
 {
-	/*! \brief Bitwise flags for deliminator declarations.
-	 * The lexer uses these flags to configure how the tokens are added to the resultant token vector.
-	 */
-	typedef enum
-	{
-		Defaults = 0x00, //! No special flags.
-		Filtered = 0x01, //! Removes the token from the token vector resultant from lexing.
-	} DeliminatorFlags;
-
 	/*! \brief Performs lexing. 
-	 * Configure this class only to configure the lexical grammar for the source language.
+	 * Configure this class only to configure the lexical grammar for the source language. The grammar is
+	 * compiled into a CompiledGrammar the first time it is lexed with after a change; to lex on several
+	 * threads at once, share the result of compile() and give each thread its own LexerState.
 	 */
 	class Lexer
 	{
 	protected:
-		/*! \brief Helper type.
-		 * Used to store deliminator start/end-points. It contains not only the
-		 * string pattern itself, but the line/column difference across the
-		 * string.
-		 */
-		typedef struct StringConstPattern
-		{
-			std::string value; //! String value.
-			int linediff, coldiff; //! Line/column difference across the string.
-
-			/*! \brief Constructor.
-			 * Initializes empty pattern.
-			 */
-			StringConstPattern() : linediff(0), coldiff(0) {}
-
-			/*! \brief Constructor.
-			 * Initializes pattern with string value.
-			 * \param v String value.
-			 */
-			StringConstPattern(std::string v);
-		} StringConstPattern;
-
-		/*! \brief Callback to be used for deliminator end-points.
-		 * \param from The current position in the string.
-		 * \param s The string to look for the end-point in.
-		 * \returns Length of the resultant deliminator.
-		 */
-		typedef int (*DeliminatorPatternCallback)(int from, std::string s);
-
-		/*! \brief Helper type.
-		 * Stores deliminator descriptions.
-		 */
-		typedef struct Deliminator
-		{
-			StringConstPattern start; //! Start point.
-			StringConstPattern end; //! End point.
-			DeliminatorFlags flags; //! Description flags.
-			DeliminatorPatternCallback patternCallback; //! A callback that can be used in leiu of the end point.
-
-			/*! \brief Constructor.
-			 * Initiates empty deliminator.
-			 */
-			Deliminator() : flags(Defaults), patternCallback(NULL) {}
-
-			/*! \brief Constructor.
-			 * Creates deliminator with start but no end point.
-			 * \param p Start point.
-			 */
-			Deliminator(StringConstPattern p) : start(p), flags(Defaults), patternCallback(NULL) {}
-
-			/*! \brief Constructor.
-			 * Creates deliminator with start and an end point specified by a callback.
-			 * \param p Start point.
-			 * \param c Pattern callback.
-			 */
-			Deliminator(StringConstPattern p, DeliminatorPatternCallback c) : start(p), flags(Defaults), patternCallback(c) {}
-
-			/*! \brief Constructor.
-			 * Creates deliminator with start and end points.
-			 * \param p Start point.
-			 * \param e End point.
-			 */
-			Deliminator(StringConstPattern s, StringConstPattern e) : 
-				start(s), end(e), patternCallback(NULL), flags(Defaults) {}
-		} Deliminator;
+		typedef CompiledGrammar::StringConstPattern StringConstPattern; //! Deliminator start/end-point.
+		typedef CompiledGrammar::Deliminator Deliminator; //! Deliminator description.
 
 		/*! \brief The set of deliminators, sorted by size and then start-point.
 		 */
@@ -144,16 +82,23 @@ namespace mitten
 		 */
 		size_t maxDelimLength;
 
-		/*! \brief Helper method to identify the tag of any given token.
-		 * \todo Optimize for better efficiency.
-		 * \param t Input token.
-		 * \return Token tag.
-		 */
-		TokenTag findTag(Token t);
-
 		/*! \brief Lexical macro dictionary. 
 		*/
-		std::unordered_map<std::string, std::vector<Token> > lexicalMacros;
+		MacroTable lexicalMacros;
+
+		/*! \brief The keywords tokens are given ids from.
+		 */
+		KeywordTable keywords;
+
+		/*! \brief The grammar as last compiled, NULL if the deliminators or macros changed since.
+		 */
+		std::shared_ptr<const CompiledGrammar> compiled;
+
+		/*! \brief The tagger settings the grammar was last compiled with.
+		 */
+		uint64_t compiledTaggers;
+
+		friend class CompiledGrammar;
 
 	public:
 		BooleanLiteralTagger boolTag; //! The boolean tag parser.
@@ -170,15 +115,24 @@ namespace mitten
 		 */
 		std::function<void (Token, std::vector<Token> &, ErrorHandler &)> onToken;
 
+		typedef LexerState::Edit Edit; //! Describes an edit to a source buffer.
+		typedef CompiledGrammar::DeliminatorPatternCallback DeliminatorPatternCallback; //! Deliminator end-point callback.
+		static const size_t NoMatch = CompiledGrammar::NoMatch; //! Returned by a pattern callback which does not match.
+
+		/*! \brief The smallest chunk of input lexParallel gives to a thread.
+		 */
+		size_t minParallelChunk;
+
 		/*! \brief Constructor.
 		 * Initializes a lexer with an empty lexical grammar.
 		 */
-		Lexer() : maxDelimLength(0) {}
+		Lexer() : maxDelimLength(0), compiledTaggers(0), minParallelChunk(65536) {}
 
 		/*! \brief Copy constructor.
-		 * Copies the lexer given completely.
+		 * Copies the lexer given completely, sharing its compiled grammar.
 		 */
-		Lexer(const Lexer &l) : boolTag(l.boolTag), intTag(l.intTag), floatTag(l.floatTag), charTag(l.charTag), stringTag(l.stringTag), symbolTag(l.symbolTag), delims(l.delims), maxDelimLength(l.maxDelimLength) {}
+		Lexer(const Lexer &l) : delims(l.delims), maxDelimLength(l.maxDelimLength), lexicalMacros(l.lexicalMacros), keywords(l.keywords), compiled(l.compiled), compiledTaggers(l.compiledTaggers), 
+			boolTag(l.boolTag), intTag(l.intTag), floatTag(l.floatTag), charTag(l.charTag), stringTag(l.stringTag), symbolTag(l.symbolTag), onToken(l.onToken), minParallelChunk(l.minParallelChunk) {}
 
 		/*! \brief Adds a new deliminator to the lexical grammar.
 		 * \param s The start point of the deliminator.
@@ -189,7 +143,7 @@ namespace mitten
 
 		/*! \brief Adds a new deliminator to the lexical grammar.
 		 * \param s The start point of the deliminator.
-		 * \param c The callback to be used to detect the end point for the deliminator.
+		 * \param c The callback to be used to detect the end point for the deliminator; see DeliminatorPatternCallback.
 		 * \returns A reference to the deliminator flags for the deliminator; set them as you please to configure the deliminator.
 		 */
 		DeliminatorFlags &deliminate(std::string s, DeliminatorPatternCallback c);
@@ -217,6 +171,40 @@ namespace mitten
 		 */
 		bool isMacroDefined(std::string s);
 
+		/*! \brief Registers a keyword.
+		 * Tokens lexed whose values are keywords, deliminators included, carry the keyword's id (see
+		 * Token::keyword), so they can be told apart without comparing strings.
+		 * \param s The keyword.
+		 * \returns The id of the keyword; ids are handed out from 1 in the order keywords are registered.
+		 */
+		KeywordId keyword(std::string s);
+
+		/*! \brief Gets the keywords registered, to look up ids by name and names by id.
+		 */
+		const KeywordTable &keywordTable() const;
+
+		/*! \brief Compiles the lexical grammar.
+		 * Returns the same object until the grammar changes. The result stays valid, and unchanged, when the
+		 * lexer is reconfigured or destroyed.
+		 */
+		std::shared_ptr<const CompiledGrammar> compile();
+
+		/*! \brief Gets a state for lexing against the compiled grammar, with this lexer's onToken and settings.
+		 */
+		LexerState state();
+
+		/*! \brief Hashes the lexical grammar.
+		 * Covers the deliminators, the tagger settings, the keywords and the lexical macros: two lexers with the same
+		 * fingerprint lex any input to the same tokens. Pattern callbacks are identified only by their
+		 * start points and onToken is not covered at all, so that only holds for lexers without callbacks; see hasCallbacks().
+		 */
+		uint64_t fingerprint();
+
+		/*! \brief Checks whether lexing runs any callbacks: onToken, or the pattern callback of a deliminator.
+		 * Their effects are not covered by the fingerprint.
+		 */
+		bool hasCallbacks();
+
 		/*! \brief Performs the actual lexical analysis.
 		 * \param s The input string.
 		 * \param f The input file name.
@@ -226,7 +214,82 @@ namespace mitten
 		 * \returns The resultant token vector.
 		 */
 		std::vector<Token> lex(std::string s, std::string f, ErrorHandler &eh, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs the actual lexical analysis on a source buffer.
+		 * The values of the resultant tokens are views into \p b rather than copies. As token offsets are
+		 * 32-bit, \p b must be smaller than 4GB; larger input can be lexed with a TokenStream.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 * \returns The resultant token vector.
+		 */
+		std::vector<Token> lex(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs lexical analysis, handing the tokens to a sink chosen at compile time.
+		 * The sink is any callable taking a const Token &, and is called with each token in turn
+		 * after macro expansion, in place of onToken; it can be inlined into the lexer's loop.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param sink The token sink.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 */
+		template <typename Sink> void lexTo(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, Sink &sink, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs lexical analysis, handing the tokens to a sink in batches.
+		 * In place of onToken, tokens are collected after macro expansion and passed to the sink
+		 * TokenSink::BatchSize at a time.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param sink The token sink.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 */
+		void lex(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, TokenSink &sink, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs lexical analysis on several threads.
+		 * The input is split into chunks at newlines, and each chunk is lexed on its own thread as
+		 * though a token began at its start. The chunks are then stitched together: wherever a chunk
+		 * was lexed from a state the sequential lexer does not reach (for example, because it starts
+		 * inside a block comment or a string), the input is re-lexed sequentially until the two agree
+		 * again. The result is identical to lex(); macros are expanded and onToken is run on the
+		 * calling thread, in order, after stitching. Pattern callbacks must be safe to call from
+		 * several threads at once.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param threads The number of threads to use, 0 for one per core.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 * \returns The resultant token vector.
+		 */
+		std::vector<Token> lexParallel(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, unsigned threads = 0, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Re-lexes a source buffer after an edit.
+		 * Lexing restarts from the last point before the edit at which no token was pending and
+		 * stops as soon as it reaches such a point in the text following the edit which the previous
+		 * lex also went through, so the cost depends on the size of the edit rather than of the
+		 * buffer. The lexical grammar must be the same as for the previous lex. If it has pattern callbacks,
+		 * which may look ahead arbitrarily far, lexing restarts from the start of the buffer instead, still
+		 * stopping early after the edit. onToken is only run on the re-lexed tokens.
+		 * \p b is added to the source table as a new entry, and only the tokens returned refer to it; \p previous
+		 * keeps reading the old buffer, whose entry can be removed once it is no longer needed. Tokens from
+		 * other files are copied unchanged.
+		 * \param previous The tokens lexed from the buffer before the edit.
+		 * \param e The edit.
+		 * \param b The buffer after the edit.
+		 * \param eh The error handler.
+		 * \param changedBegin Set to the index of the first re-lexed token in the result.
+		 * \param changedEnd Set to the index after the last re-lexed token in the result.
+		 * \returns The token vector for \p b; tokens outside of the changed range are moved over from \p previous.
+		 */
+		std::vector<Token> relex(const std::vector<Token> &previous, Edit e, std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, size_t &changedBegin, size_t &changedEnd);
 	};
+
+	template <typename Sink> void Lexer::lexTo(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, Sink &sink, int lineoff, int columnoff)
+	{
+		state().lexTo(b, eh, sink, lineoff, columnoff);
+	}
 }
 
 #endif
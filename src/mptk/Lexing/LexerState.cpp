@@ -0,0 +1,308 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "LexerState.h"
+
+#include <cstring>
+#include <thread>
+#include <exception>
+#include <algorithm>
+
+using namespace std;
+
+namespace mitten
+{
+	void LexerState::emit(Token t, std::vector<Token> &rtn, ErrorHandler &eh)
+	{
+		MacroTable::Body body = _grammar->findMacro(t.view());
+		if (!body)
+		{
+			if (onToken)
+				onToken(t, rtn, eh);
+			else
+				rtn.push_back(t);
+		}
+		else if (onToken)
+		{
+			for (auto &i : *body)
+				onToken(i, rtn, eh);
+		}
+		else
+		{
+			rtn.insert(rtn.end(), body->begin(), body->end());
+		}
+	}
+
+	size_t LexerState::scan(StringRef s, SourceTable::FileId f, bool final, std::vector<Token> &rtn, ErrorHandler &eh, CompiledGrammar::PendingEnd *pending)
+	{
+		return _grammar->scanSpan(s, f, 0, string::npos, final, [&](Token t, bool)
+		{
+			emit(t, rtn, eh);
+		}, pending);
+	}
+
+	void LexerState::scanChunk(StringRef s, SourceTable::FileId f, size_t from, size_t until, Chunk &c) const
+	{
+		c.syncs.push_back(make_pair(from, (size_t)0));
+		c.stop = _grammar->scanSpan(s, f, from, until, true, [&c](Token t, bool delim)
+		{
+			c.tokens.push_back(t);
+			if (delim)
+				c.syncs.push_back(make_pair((size_t)(t.offset()+t.length()), c.tokens.size()));
+		});
+	}
+
+	std::vector<Token> LexerState::lex(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff, int columnoff)
+	{
+		std::vector<Token> rtn;
+		SourceTable::FileId f = SourceTable::global().add(b, (lineoff > 1 ? lineoff : 1), (columnoff > 0 ? columnoff : 0));
+		scan(b->view(), f, true, rtn, eh);
+		return rtn;
+	}
+
+	void LexerState::lex(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, TokenSink &sink, int lineoff, int columnoff)
+	{
+		vector<Token> batch;
+		batch.reserve(TokenSink::BatchSize);
+
+		auto collect = [&](const Token &t)
+		{
+			batch.push_back(t);
+			if (batch.size() == TokenSink::BatchSize)
+			{
+				sink.consume(batch.data(), batch.size(), eh);
+				batch.clear();
+			}
+		};
+		lexTo(b, eh, collect, lineoff, columnoff);
+
+		if (!batch.empty())
+			sink.consume(batch.data(), batch.size(), eh);
+		sink.finish(eh);
+	}
+
+	std::vector<Token> LexerState::lexParallel(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, unsigned threads, int lineoff, int columnoff)
+	{
+		StringRef s = b->view();
+
+		if (threads == 0)
+			threads = thread::hardware_concurrency();
+		if (minParallelChunk > 0 && threads > s.size()/minParallelChunk)
+			threads = s.size()/minParallelChunk;
+		if (threads < 2)
+			return lex(b, eh, lineoff, columnoff);
+
+		SourceTable::FileId f = SourceTable::global().add(b, (lineoff > 1 ? lineoff : 1), (columnoff > 0 ? columnoff : 0));
+
+		vector<size_t> starts(1, 0);
+		for (unsigned k = 1; k < threads; k++)
+		{
+			const char *p = (const char *)memchr(s.data()+s.size()/threads*k, '\n', s.size()-s.size()/threads*k);
+			if (p == NULL || p+1 >= s.end())
+				break;
+			if ((size_t)(p+1-s.data()) > starts.back())
+				starts.push_back(p+1-s.data());
+		}
+		starts.push_back(s.size());
+
+		vector<Chunk> chunks(starts.size()-1);
+		vector<exception_ptr> errors(chunks.size());
+		vector<thread> workers;
+		for (size_t k = 0; k < chunks.size(); k++)
+		{
+			workers.push_back(thread([&, k]()
+			{
+				try
+				{
+					scanChunk(s, f, starts[k], starts[k+1], chunks[k]);
+				}
+				catch(...)
+				{
+					errors[k] = current_exception();
+				}
+			}));
+		}
+
+		for (auto &i : workers)
+			i.join();
+		for (auto &i : errors)
+		{
+			if (i)
+				rethrow_exception(i);
+		}
+
+		vector<Token> toks;
+		size_t pos = 0;
+		size_t k = 0;
+		while (pos < s.size())
+		{
+			while (k+1 < chunks.size() && starts[k+1] <= pos)
+				k++;
+
+			Chunk &c = chunks[k];
+			auto j = lower_bound(c.syncs.begin(), c.syncs.end(), make_pair(pos, (size_t)0));
+			if (j != c.syncs.end() && j->first == pos)
+			{
+				toks.insert(toks.end(), c.tokens.begin()+j->second, c.tokens.end());
+				pos = c.stop;
+			}
+			else
+			{
+				Chunk tmp;
+				scanChunk(s, f, pos, pos+1, tmp);
+				toks.insert(toks.end(), tmp.tokens.begin(), tmp.tokens.end());
+				pos = tmp.stop;
+			}
+		}
+
+		vector<Token> rtn;
+		for (auto &i : toks)
+			emit(i, rtn, eh);
+		return rtn;
+	}
+
+	std::vector<Token> LexerState::relex(const std::vector<Token> &previous, Edit e, shared_ptr<const SourceBuffer> b, ErrorHandler &eh, size_t &changedBegin, size_t &changedEnd)
+	{
+		SourceTable &table = SourceTable::global();
+		long shift = (long)e.inserted-(long)e.removed;
+
+		// The buffer lexed from is the first one the edit fits; tokens from other buffers, such as those of
+		// macro bodies, are left alone.
+		SourceTable::FileId of = 0;
+		shared_ptr<const SourceBuffer> old;
+		for (auto &i : previous)
+		{
+			if (i.owned() || (old && i.fileId() == of))
+				continue;
+
+			shared_ptr<const SourceBuffer> o = table.buffer(i.fileId());
+			if (o && (long)o->size()+shift == (long)b->size() && e.offset+e.removed <= o->size())
+			{
+				of = i.fileId();
+				old = o;
+				break;
+			}
+		}
+
+		if (!old)
+		{
+			vector<Token> rtn = lex(b, eh);
+			changedBegin = 0;
+			changedEnd = rtn.size();
+			return rtn;
+		}
+
+		auto inFile = [&previous, of](size_t i)
+		{
+			return (!previous[i].owned() && previous[i].fileId() == of);
+		};
+
+		// The edited buffer gets an entry of its own, so that the previous tokens keep reading the old one.
+		int line, column;
+		table.origin(of, line, column);
+		SourceTable::FileId f = table.add(b, line, column);
+
+		StringRef os = old->view();
+		StringRef s = b->view();
+
+		// Deliminators are matched at most _grammar->maxDeliminatorLength() bytes ahead, so tokens ending before cut did not see the edit.
+		size_t cut = (e.offset > _grammar->maxDeliminatorLength() ? e.offset-_grammar->maxDeliminatorLength() : 0);
+		size_t lo = 0;
+		size_t hi = previous.size();
+		while (lo < hi)
+		{
+			size_t mid = lo+(hi-lo)/2;
+			size_t m = mid;
+			while (m < hi && !inFile(m))
+				m++;
+
+			if (m < hi && previous[m].offset() <= cut)
+				lo = m+1;
+			else
+				hi = mid;
+		}
+
+		// A pattern callback may have looked ahead into the edited text from anywhere before it, whether or
+		// not it matched, so such grammars are re-lexed from the start.
+		size_t r = (_grammar->hasPatternCallbacks() ? 0 : lo);
+		while (r > 0 && !_grammar->isSyncPoint(previous, r-1, os, of))
+			r--;
+
+		size_t pos = 0;
+		if (r > 0)
+		{
+			r--;
+			pos = previous[r].offset();
+		}
+
+		vector<Token> raw;
+		size_t j = r;
+		bool synced = false;
+		while (pos < s.size() && !synced)
+		{
+			pos = _grammar->scanSpan(s, f, pos, pos+1, true, [&raw](Token t, bool)
+			{
+				raw.push_back(t);
+			});
+
+			if (pos >= e.offset+e.inserted && pos < s.size())
+			{
+				size_t x = (size_t)((long)pos-shift);
+				while (j < previous.size() && (!inFile(j) || previous[j].offset() < x))
+					j++;
+				synced = (j < previous.size() && previous[j].offset() == x && _grammar->isSyncPoint(previous, j, os, of));
+			}
+		}
+
+		if (!synced)
+			j = previous.size();
+
+		vector<Token> rtn;
+		rtn.reserve(r+raw.size()+previous.size()-j);
+		for (size_t i = 0; i < r; i++)
+			rtn.push_back(inFile(i) ? previous[i].rebased(f, 0) : previous[i]);
+
+		changedBegin = rtn.size();
+		for (auto &i : raw)
+			emit(i, rtn, eh);
+		changedEnd = rtn.size();
+
+		for (size_t i = j; i < previous.size(); i++)
+			rtn.push_back(inFile(i) ? previous[i].rebased(f, shift) : previous[i]);
+
+		return rtn;
+	}
+}
@@ -0,0 +1,235 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MITTEN_LEXER_STATE_H
+#define __MITTEN_LEXER_STATE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "../Core/Token.h"
+#include "../Core/SourceBuffer.h"
+#include "../Core/ErrorHandler.h"
+#include "CompiledGrammar.h"
+#include "TokenSink.h"
+
+namespace mitten
+{
+	/*! \brief Lexes input against a compiled grammar.
+	 * Holds what a lex needs besides the grammar itself: the onToken callback and the parallel lexing
+	 * settings. Lexer states are cheap to create, so give each thread (or each file) its own, all sharing
+	 * one CompiledGrammar.
+	 */
+	class LexerState
+	{
+	protected:
+		std::shared_ptr<const CompiledGrammar> _grammar; //! The grammar lexed against.
+
+		/*! \brief Helper type.
+		 * The tokens lexed speculatively from one chunk of the input by lexParallel.
+		 */
+		typedef struct Chunk
+		{
+			std::vector<Token> tokens; //! The tokens lexed.
+			std::vector<std::pair<size_t, size_t> > syncs; //! The offsets at which no token was pending, each with the number of tokens lexed before it.
+			size_t stop; //! The offset lexing stopped at.
+
+			/*! \brief Constructor.
+			 * Initializes an empty chunk.
+			 */
+			Chunk() : stop(0) {}
+		} Chunk;
+
+		/*! \brief Lexes a chunk of the input for lexParallel.
+		 * Lexing goes on past \p until to the end of the first deliminator reaching it.
+		 */
+		void scanChunk(StringRef s, SourceTable::FileId f, size_t from, size_t until, Chunk &c) const;
+
+	public:
+		/*! \brief Callback which is run upon recieving token.
+		 * The first argument is the token which was lexed. The second is the current vector
+		 * of tokens. To replicate default behavior (tokens lexed are added to the results vector)
+		 * simply append the token lexed to the back of the vector.
+		 */
+		std::function<void (Token, std::vector<Token> &, ErrorHandler &)> onToken;
+
+		/*! \brief Describes an edit to a source buffer: a byte range replaced by new text.
+		 */
+		typedef struct Edit
+		{
+			size_t offset; //! The offset of the range replaced.
+			size_t removed; //! The length of the range replaced.
+			size_t inserted; //! The length of the text it was replaced with.
+
+			/*! \brief Constructor.
+			 * \param o The offset of the range replaced.
+			 * \param r The length of the range replaced.
+			 * \param i The length of the text it was replaced with.
+			 */
+			Edit(size_t o, size_t r, size_t i) : offset(o), removed(r), inserted(i) {}
+		} Edit;
+
+		/*! \brief The smallest chunk of input lexParallel gives to a thread.
+		 */
+		size_t minParallelChunk;
+
+		/*! \brief Constructor.
+		 * \param g The grammar to lex against.
+		 */
+		LexerState(std::shared_ptr<const CompiledGrammar> g) : _grammar(g), minParallelChunk(65536) {}
+
+		/*! \brief Gets the grammar lexed against. */
+		const CompiledGrammar &grammar() const { return *_grammar; }
+
+		/*! \brief Gets the fingerprint of the grammar lexed against. */
+		uint64_t fingerprint() const { return _grammar->fingerprint(); }
+
+		/*! \brief Checks whether lexing runs any callbacks: onToken, or the pattern callback of a deliminator. */
+		bool hasCallbacks() const { return (onToken != nullptr || _grammar->hasPatternCallbacks()); }
+
+		/*! \brief Hands a lexed token to onToken, or appends it to \p rtn, expanding lexical macros.
+		 */
+		void emit(Token t, std::vector<Token> &rtn, ErrorHandler &eh);
+
+		/*! \brief Lexes a string registered in the source table.
+		 * When \p final is false, \p s is only a prefix of the input: lexing stops before the
+		 * first token which more input could still change, so that the caller can rescan from
+		 * there once more input is available.
+		 * \param s The input string.
+		 * \param f The file id of \p s in the source table.
+		 * \param final Whether \p s runs up to the end of the input.
+		 * \param rtn The token vector to append to.
+		 * \param eh The error handler.
+		 * \param pending If not NULL, set to the end-point lexing stopped to wait for, if any.
+		 * \returns The offset up to which \p s was lexed.
+		 */
+		size_t scan(StringRef s, SourceTable::FileId f, bool final, std::vector<Token> &rtn, ErrorHandler &eh, CompiledGrammar::PendingEnd *pending = NULL);
+
+		/*! \brief Performs the actual lexical analysis on a source buffer.
+		 * The values of the resultant tokens are views into \p b rather than copies. As token offsets are
+		 * 32-bit, \p b must be smaller than 4GB; larger input can be lexed with a TokenStream.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 * \returns The resultant token vector.
+		 */
+		std::vector<Token> lex(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs lexical analysis, handing the tokens to a sink chosen at compile time.
+		 * The sink is any callable taking a const Token &, and is called with each token in turn
+		 * after macro expansion, in place of onToken; it can be inlined into the lexer's loop.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param sink The token sink.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 */
+		template <typename Sink> void lexTo(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, Sink &sink, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs lexical analysis, handing the tokens to a sink in batches.
+		 * In place of onToken, tokens are collected after macro expansion and passed to the sink
+		 * TokenSink::BatchSize at a time.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param sink The token sink.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 */
+		void lex(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, TokenSink &sink, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs lexical analysis on several threads.
+		 * The input is split into chunks at newlines, and each chunk is lexed on its own thread as
+		 * though a token began at its start. The chunks are then stitched together: wherever a chunk
+		 * was lexed from a state the sequential lexer does not reach (for example, because it starts
+		 * inside a block comment or a string), the input is re-lexed sequentially until the two agree
+		 * again. The result is identical to lex(); macros are expanded and onToken is run on the
+		 * calling thread, in order, after stitching. Pattern callbacks must be safe to call from
+		 * several threads at once.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param threads The number of threads to use, 0 for one per core.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 * \returns The resultant token vector.
+		 */
+		std::vector<Token> lexParallel(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, unsigned threads = 0, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Re-lexes a source buffer after an edit.
+		 * Lexing restarts from the last point before the edit at which no token was pending and
+		 * stops as soon as it reaches such a point in the text following the edit which the previous
+		 * lex also went through, so the cost depends on the size of the edit rather than of the
+		 * buffer. The lexical grammar must be the same as for the previous lex. If it has pattern callbacks,
+		 * which may look ahead arbitrarily far, lexing restarts from the start of the buffer instead, still
+		 * stopping early after the edit. onToken is only run on the re-lexed tokens.
+		 * \p b is added to the source table as a new entry, and only the tokens returned refer to it; \p previous
+		 * keeps reading the old buffer, whose entry can be removed once it is no longer needed. Tokens from
+		 * other files are copied unchanged.
+		 * \param previous The tokens lexed from the buffer before the edit.
+		 * \param e The edit.
+		 * \param b The buffer after the edit.
+		 * \param eh The error handler.
+		 * \param changedBegin Set to the index of the first re-lexed token in the result.
+		 * \param changedEnd Set to the index after the last re-lexed token in the result.
+		 * \returns The token vector for \p b; tokens outside of the changed range are moved over from \p previous.
+		 */
+		std::vector<Token> relex(const std::vector<Token> &previous, Edit e, std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, size_t &changedBegin, size_t &changedEnd);
+	};
+
+	template <typename Sink> void LexerState::lexTo(std::shared_ptr<const SourceBuffer> b, ErrorHandler &, Sink &sink, int lineoff, int columnoff)
+	{
+		SourceTable::FileId f = SourceTable::global().add(b, (lineoff > 1 ? lineoff : 1), (columnoff > 0 ? columnoff : 0));
+
+		_grammar->scanSpan(b->view(), f, 0, std::string::npos, true, [&](Token t, bool)
+		{
+			MacroTable::Body body = _grammar->findMacro(t.view());
+			if (!body)
+			{
+				sink(t);
+			}
+			else
+			{
+				for (auto &i : *body)
+					sink(i);
+			}
+		});
+	}
+}
+
+#endif
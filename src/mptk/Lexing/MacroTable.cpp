@@ -0,0 +1,176 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "MacroTable.h"
+#include "../Core/Utils.h"
+
+using namespace std;
+
+namespace mitten
+{
+	uint64_t MacroTable::hash(StringRef s)
+	{
+		uint64_t rtn = 14695981039346656037ULL;
+		for (auto i : s)
+		{
+			rtn ^= (unsigned char)i;
+			rtn *= 1099511628211ULL;
+		}
+		return rtn;
+	}
+
+	size_t MacroTable::slot(StringRef s, uint64_t h) const
+	{
+		size_t mask = slots.size()-1;
+		size_t i = h & mask;
+		while (slots[i].body && (slots[i].hash != h || StringRef(slots[i].name) != s))
+			i = (i+1) & mask;
+		return i;
+	}
+
+	void MacroTable::refilter()
+	{
+		lengths = 0;
+		for (int i = 0; i < 4; i++)
+			firstBytes[i] = 0;
+
+		for (auto &i : slots)
+		{
+			if (!i.body)
+				continue;
+
+			lengths |= 1ULL << (i.name.size() < 63 ? i.name.size() : 63);
+			if (!i.name.empty())
+			{
+				unsigned char c = i.name[0];
+				firstBytes[c >> 6] |= 1ULL << (c & 63);
+			}
+		}
+	}
+
+	MacroTable::MacroTable() : slots(16), count(0), lengths(0)
+	{
+		for (int i = 0; i < 4; i++)
+			firstBytes[i] = 0;
+	}
+
+	void MacroTable::define(const string &name, vector<Token> body)
+	{
+		if ((count+1)*2 > slots.size())
+		{
+			vector<Entry> old(slots.size()*2);
+			old.swap(slots);
+			for (auto &i : old)
+			{
+				if (i.body)
+					slots[slot(i.name, i.hash)] = i;
+			}
+		}
+
+		uint64_t h = hash(name);
+		Entry &e = slots[slot(name, h)];
+		if (!e.body)
+			count++;
+
+		e.hash = h;
+		e.name = name;
+		e.body = make_shared<const vector<Token> >(body);
+		refilter();
+	}
+
+	void MacroTable::undefine(const string &name)
+	{
+		size_t mask = slots.size()-1;
+		size_t i = slot(name, hash(name));
+		if (!slots[i].body)
+			return;
+
+		slots[i] = Entry();
+		count--;
+
+		// Shift back the entries which probed past the removed one.
+		for (size_t j = (i+1) & mask; slots[j].body; j = (j+1) & mask)
+		{
+			size_t k = slots[j].hash & mask;
+			if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j)))
+			{
+				slots[i] = slots[j];
+				slots[j] = Entry();
+				i = j;
+			}
+		}
+
+		refilter();
+	}
+
+	MacroTable::Body MacroTable::find(StringRef name) const
+	{
+		if (count == 0)
+			return Body();
+
+		if (!(lengths & (1ULL << (name.size() < 63 ? name.size() : 63))))
+			return Body();
+
+		if (!name.empty())
+		{
+			unsigned char c = name[0];
+			if (!(firstBytes[c >> 6] & (1ULL << (c & 63))))
+				return Body();
+		}
+
+		return slots[slot(name, hash(name))].body;
+	}
+
+	uint64_t MacroTable::fingerprint() const
+	{
+		uint64_t rtn = count;
+		for (auto &i : slots)
+		{
+			if (!i.body)
+				continue;
+
+			uint64_t h = i.hash;
+			for (auto &j : *i.body)
+			{
+				StringRef v = j.view();
+				h = hashBytes(v.data(), v.size(), h ^ ((uint64_t)j.tag() << 1) ^ (j.filtered() ? 1 : 0));
+			}
+			rtn += h;
+		}
+		return rtn;
+	}
+}
@@ -0,0 +1,123 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_MACRO_TABLE_H
+#define __MITTEN_MACRO_TABLE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "../Core/Token.h"
+
+namespace mitten
+{
+	/*! \brief The lexical macros of a lexer.
+	 * Every token lexed is looked up here, so lookups are made cheap for the common case of a token
+	 * which is not a macro: an empty table is rejected right away, names are filtered by length and
+	 * first byte before being hashed, and each entry stores its hash so that most mismatches are
+	 * rejected without comparing names. Bodies are shared, immutable token vectors; expanding a
+	 * macro appends one as a span instead of copying it token by token.
+	 */
+	class MacroTable
+	{
+	public:
+		typedef std::shared_ptr<const std::vector<Token> > Body; //! The tokens a macro expands to.
+
+	protected:
+		/*! \brief Helper type.
+		 * A slot of the hash table, empty if its body is NULL.
+		 */
+		typedef struct Entry
+		{
+			uint64_t hash; //! The hash of the name.
+			std::string name; //! The name of the macro.
+			Body body; //! The body of the macro.
+
+			/*! \brief Constructor.
+			 * Initializes an empty slot.
+			 */
+			Entry() : hash(0) {}
+		} Entry;
+
+		std::vector<Entry> slots; //! The linearly probed hash table; its size is a power of two.
+		size_t count; //! The number of macros defined.
+		uint64_t lengths; //! Bit n is set if a name is n bytes long, bit 63 if a name is longer.
+		uint64_t firstBytes[4]; //! The set of first bytes of the names.
+
+		/*! \brief Hashes a macro name. */
+		static uint64_t hash(StringRef s);
+
+		/*! \brief Finds the slot of a name, or the empty slot where it would go. */
+		size_t slot(StringRef s, uint64_t h) const;
+
+		/*! \brief Rebuilds the length and first byte filters. */
+		void refilter();
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes an empty table.
+		 */
+		MacroTable();
+
+		/*! \brief Defines a macro, replacing any previous definition. */
+		void define(const std::string &name, std::vector<Token> body);
+
+		/*! \brief Undefines a macro, if it is defined. */
+		void undefine(const std::string &name);
+
+		/*! \brief Looks up a macro.
+		 * \returns The body of the macro, NULL if it is not defined.
+		 */
+		Body find(StringRef name) const;
+
+		/*! \brief Hashes the names and bodies of the macros defined.
+		 * Does not depend on the order macros were defined in.
+		 */
+		uint64_t fingerprint() const;
+
+		/*! \brief Checks whether no macros are defined. */
+		bool empty() const { return count == 0; }
+
+		/*! \brief Gets the number of macros defined. */
+		size_t size() const { return count; }
+	};
+}
+
+#endif
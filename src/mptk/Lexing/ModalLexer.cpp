@@ -0,0 +1,129 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ModalLexer.h"
+
+using namespace std;
+
+namespace mitten
+{
+	void ModalLexer::compile()
+	{
+		bool changed = transitionsChanged || compiled.size() != modes.size();
+		compiled.resize(modes.size());
+		for (size_t i = 0; i < modes.size(); i++)
+		{
+			shared_ptr<const CompiledGrammar> g = modes[i].lexer.compile();
+			if (g != compiled[i].grammar)
+			{
+				compiled[i].grammar = g;
+				changed = true;
+			}
+		}
+
+		if (!changed)
+			return;
+
+		for (size_t i = 0; i < modes.size(); i++)
+		{
+			compiled[i].transitions.clear();
+			for (auto &j : modes[i].transitions)
+			{
+				const CompiledGrammar::Deliminator *d = compiled[i].grammar->findDeliminator(j.first);
+				if (d == NULL)
+					throw runtime_error("mode '"+modes[i].name+"' switches modes on '"+j.first+"', which it no longer deliminates.");
+
+				size_t target = (j.second.kind == PushMode ? modeIndex(j.second.target) : 0);
+				compiled[i].transitions[d] = pair<TransitionKind, size_t>(j.second.kind, target);
+			}
+		}
+
+		transitionsChanged = false;
+	}
+
+	Lexer &ModalLexer::mode(string name)
+	{
+		auto i = modeIndices.find(name);
+		if (i != modeIndices.end())
+			return modes[i->second].lexer;
+
+		modeIndices[name] = modes.size();
+		modes.push_back(Mode());
+		modes.back().name = name;
+		return modes.back().lexer;
+	}
+
+	size_t ModalLexer::modeIndex(string name) const
+	{
+		auto i = modeIndices.find(name);
+		if (i == modeIndices.end())
+			throw runtime_error("undefined lexer mode '"+name+"'.");
+		return i->second;
+	}
+
+	DeliminatorFlags &ModalLexer::push(string from, string s, string to, string e)
+	{
+		mode(to);
+		DeliminatorFlags &rtn = mode(from).deliminate(s, e);
+		Transition t;
+		t.kind = PushMode;
+		t.target = to;
+		modes[modeIndex(from)].transitions[s] = t;
+		transitionsChanged = true;
+		return rtn;
+	}
+
+	DeliminatorFlags &ModalLexer::pop(string from, string s, string e)
+	{
+		DeliminatorFlags &rtn = mode(from).deliminate(s, e);
+		Transition t;
+		t.kind = PopMode;
+		modes[modeIndex(from)].transitions[s] = t;
+		transitionsChanged = true;
+		return rtn;
+	}
+
+	vector<Token> ModalLexer::lex(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff, int columnoff)
+	{
+		vector<Token> rtn;
+		auto append = [&rtn](const Token &t, size_t)
+		{
+			rtn.push_back(t);
+		};
+		lexTo(b, eh, append, lineoff, columnoff);
+		return rtn;
+	}
+}
@@ -0,0 +1,223 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MITTEN_MODAL_LEXER_H
+#define __MITTEN_MODAL_LEXER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+#include "../Core/Token.h"
+#include "../Core/SourceBuffer.h"
+#include "../Core/ErrorHandler.h"
+#include "CompiledGrammar.h"
+#include "Lexer.h"
+
+namespace mitten
+{
+	/*! \brief Performs lexing with several lexical grammars, switched between by deliminators.
+	 * Each mode is a named Lexer, configured as usual. Deliminators added with push() or pop() also switch
+	 * modes when they are lexed: push() enters another mode on top of a stack of modes, and pop() returns to
+	 * the mode below it. Lexing starts in the first mode defined, and the whole input is lexed in one pass.
+	 * The mode stack lives only as long as a lex, so one ModalLexer can lex any number of inputs; to lex on
+	 * several threads at once, give each thread its own copy, which shares the compiled grammars.
+	 */
+	class ModalLexer
+	{
+	public:
+		/*! \brief What lexing a deliminator does to the mode stack.
+		 */
+		typedef enum
+		{
+			PushMode, //! Enters a mode.
+			PopMode //! Returns to the mode below the current one.
+		} TransitionKind;
+
+	protected:
+		/*! \brief Helper type.
+		 * A mode switch caused by a deliminator.
+		 */
+		typedef struct Transition
+		{
+			TransitionKind kind; //! What the deliminator does.
+			std::string target; //! The name of the mode entered, if any.
+		} Transition;
+
+		/*! \brief Helper type.
+		 * A named lexical grammar and the mode switches its deliminators cause.
+		 */
+		typedef struct Mode
+		{
+			std::string name; //! The name of the mode.
+			Lexer lexer; //! The grammar of the mode.
+			std::unordered_map<std::string, Transition> transitions; //! The mode switches, by deliminator start-point.
+		} Mode;
+
+		/*! \brief Helper type.
+		 * A mode as compiled for lexing; transitions refer to deliminators of the compiled grammar and to
+		 * modes by index.
+		 */
+		typedef struct CompiledMode
+		{
+			std::shared_ptr<const CompiledGrammar> grammar; //! The compiled grammar of the mode.
+			std::unordered_map<const CompiledGrammar::Deliminator *, std::pair<TransitionKind, size_t> > transitions; //! The mode switches.
+		} CompiledMode;
+
+		std::deque<Mode> modes; //! The modes, the initial one first.
+		std::unordered_map<std::string, size_t> modeIndices; //! The index of each mode by name.
+		std::vector<CompiledMode> compiled; //! The modes as last compiled.
+		bool transitionsChanged; //! Whether transitions were added since the modes were last compiled.
+
+		/*! \brief Compiles any mode whose grammar changed since the last lex.
+		 */
+		void compile();
+
+	public:
+		/*! \brief Constructor.
+		 * Initializes a lexer with no modes.
+		 */
+		ModalLexer() : transitionsChanged(false) {}
+
+		/*! \brief Gets a mode, defining it if needed.
+		 * The first mode defined is the one lexing starts in.
+		 * \param name The name of the mode.
+		 * \returns The lexer holding the grammar of the mode; configure it as you please.
+		 */
+		Lexer &mode(std::string name);
+
+		/*! \brief Gets the index of a mode, as passed to lexTo sinks.
+		 * Throws a runtime_error if the mode is not defined.
+		 */
+		size_t modeIndex(std::string name) const;
+
+		/*! \brief Adds a deliminator which enters another mode.
+		 * \param from The mode the deliminator is lexed in.
+		 * \param s The start point of the deliminator.
+		 * \param to The mode entered after the deliminator.
+		 * \param e An optional end point for the deliminator.
+		 * \returns A reference to the deliminator flags for the deliminator.
+		 */
+		DeliminatorFlags &push(std::string from, std::string s, std::string to, std::string e = "");
+
+		/*! \brief Adds a deliminator which returns to the mode below.
+		 * A pop lexed in the initial mode leaves it as it is.
+		 * \param from The mode the deliminator is lexed in.
+		 * \param s The start point of the deliminator.
+		 * \param e An optional end point for the deliminator.
+		 * \returns A reference to the deliminator flags for the deliminator.
+		 */
+		DeliminatorFlags &pop(std::string from, std::string s, std::string e = "");
+
+		/*! \brief Performs lexical analysis on a source buffer.
+		 * Lexical macros of each mode are expanded; onToken is not run.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \param coloff The starting column number (from 0), -1 if none.
+		 * \returns The resultant token vector.
+		 */
+		std::vector<Token> lex(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Performs lexical analysis, handing the tokens to a sink chosen at compile time.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param sink Called with each token and the index of the mode it was lexed in.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \param coloff The starting column number (from 0), -1 if none.
+		 */
+		template <typename Sink> void lexTo(std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, Sink &sink, int lineoff = -1, int columnoff = -1);
+	};
+
+	template <typename Sink> void ModalLexer::lexTo(std::shared_ptr<const SourceBuffer> b, ErrorHandler &, Sink &sink, int lineoff, int columnoff)
+	{
+		if (modes.empty())
+			throw std::runtime_error("cannot lex without a mode.");
+
+		compile();
+
+		SourceTable::FileId f = SourceTable::global().add(b, (lineoff > 1 ? lineoff : 1), (columnoff > 0 ? columnoff : 0));
+		StringRef s = b->view();
+		std::vector<size_t> stack(1, 0);
+
+		size_t pos = 0;
+		while (pos < s.size())
+		{
+			size_t current = stack.back();
+			const CompiledMode &m = compiled[current];
+			const std::pair<TransitionKind, size_t> *next = NULL;
+
+			// Lex in the current mode until a deliminator switches modes.
+			size_t until = std::string::npos;
+			pos = m.grammar->scanRaw(s, pos, until, true, [&](size_t o, size_t n, TokenTag t, bool filtered, const CompiledGrammar::Deliminator *d, KeywordId k)
+			{
+				Token tok(f, o, n, t, filtered, k);
+				MacroTable::Body body = m.grammar->findMacro(tok.view());
+				if (!body)
+				{
+					sink(tok, current);
+				}
+				else
+				{
+					for (auto &i : *body)
+						sink(i, current);
+				}
+
+				if (d != NULL && !m.transitions.empty())
+				{
+					auto i = m.transitions.find(d);
+					if (i != m.transitions.end())
+					{
+						next = &i->second;
+						until = 0;
+					}
+				}
+			});
+
+			if (next != NULL)
+			{
+				if (next->first == PushMode)
+					stack.push_back(next->second);
+				else if (stack.size() > 1)
+					stack.pop_back();
+			}
+		}
+	}
+}
+
+#endif
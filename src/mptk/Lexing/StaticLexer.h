@@ -0,0 +1,306 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_STATIC_LEXER_H
+#define __MITTEN_STATIC_LEXER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "../Core/Token.h"
+#include "../Core/SourceBuffer.h"
+#include "../Core/SourceTable.h"
+#include "../Core/ErrorHandler.h"
+#include "../Core/Utils.h"
+#include "Lexer.h"
+
+namespace mitten
+{
+	/*! \brief A deliminator start or end point known at compile time.
+	 * Spelled out one character at a time, as in Chars<'/', '*'>.
+	 */
+	template <char... C> struct Chars;
+
+	template <> struct Chars<>
+	{
+		static const size_t size = 0; //! Length of the pattern.
+
+		/*! \brief Gets the pattern, null-terminated. */
+		static const char *data() { return ""; }
+
+		/*! \brief Checks whether the pattern starts at \p p, which must have at least size bytes. */
+		static bool matches(const char *) { return true; }
+	};
+
+	template <char H, char... T> struct Chars<H, T...>
+	{
+		static const size_t size = 1+sizeof...(T); //! Length of the pattern.
+
+		/*! \brief Gets the pattern, null-terminated. */
+		static const char *data()
+		{
+			static const char value[] = {H, T..., '\0'};
+			return value;
+		}
+
+		/*! \brief Checks whether the pattern starts at \p p, which must have at least size bytes. */
+		static bool matches(const char *p) { return (p[0] == H && Chars<T...>::matches(p+1)); }
+	};
+
+	/*! \brief A deliminator known at compile time.
+	 * \tparam S The start point, a Chars.
+	 * \tparam E The end point, Chars<> if none.
+	 * \tparam F The deliminator flags.
+	 */
+	template <typename S, typename E = Chars<>, int F = Defaults> struct StaticDeliminator
+	{
+		static_assert(S::size > 0, "cannot deliminate empty string");
+
+		typedef S Start; //! The start point.
+		typedef E End; //! The end point.
+		static const int flags = F; //! The deliminator flags.
+	};
+
+	/*! \brief A lexer for a lexical grammar fixed at compile time.
+	 * The deliminators are given as StaticDeliminator template arguments. Each is compiled into an
+	 * unrolled byte comparison, and at every position only the deliminators starting with the byte
+	 * found there are tried, longest first, so no hashing or trie walk is involved. The tokens produced are the
+	 * same as those of a Lexer given the same deliminators in the same order (later declarations of a
+	 * start point win, as they replace earlier ones in a Lexer), without macros or an onToken callback.
+	 * Pattern callbacks are not supported.
+	 */
+	template <typename... D> class StaticLexer
+	{
+	protected:
+		/*! \brief Helper type.
+		 * A deliminator compiled into a pair of functions.
+		 */
+		typedef struct Entry
+		{
+			size_t size; //! The length of the start point.
+			int order; //! The position of the deliminator in the template arguments.
+			bool (*matches)(const char *); //! Checks whether the start point begins at a position with enough input left.
+			size_t (*extent)(const char *, const char *, bool &); //! Finds the length of the deliminator, and whether it is filtered.
+		} Entry;
+
+		/*! \brief Helper type.
+		 * Compiles the deliminators from the Ith on.
+		 */
+		template <int I, typename... L> struct Compiler
+		{
+			static void compile(std::vector<std::pair<unsigned char, Entry> > &) {}
+			static void deliminate(Lexer &) {}
+			static uint64_t fingerprint() { return 0; }
+		};
+
+		template <int I, typename H, typename... T> struct Compiler<I, H, T...>
+		{
+			static size_t extent(const char *p, const char *e, bool &filtered)
+			{
+				filtered = ((H::flags & Filtered) != 0);
+				size_t dl = H::Start::size;
+				if (H::End::size > 0)
+				{
+					const char *q = findBytes(p+dl, e, H::End::data(), H::End::size);
+					dl = (q != NULL ? q-p+H::End::size : e-p);
+				}
+				return dl;
+			}
+
+			static void compile(std::vector<std::pair<unsigned char, Entry> > &v)
+			{
+				Entry e = {H::Start::size, I, &H::Start::matches, &extent};
+				v.push_back(std::make_pair((unsigned char)H::Start::data()[0], e));
+				Compiler<I+1, T...>::compile(v);
+			}
+
+			static void deliminate(Lexer &l)
+			{
+				l.deliminate(H::Start::data(), H::End::data()) = (DeliminatorFlags)H::flags;
+				Compiler<I+1, T...>::deliminate(l);
+			}
+
+			static uint64_t fingerprint()
+			{
+				// The index is mixed in, since the terms are summed and a later duplicate start point wins.
+				uint64_t h = hashBytes(H::Start::data(), H::Start::size, (uint64_t)H::flags*2+((uint64_t)I << 32));
+				return hashBytes(H::End::data(), H::End::size, h)+Compiler<I+1, T...>::fingerprint();
+			}
+		};
+
+		std::vector<Entry> entries; //! The deliminators, grouped by first byte and longest first within a group.
+		size_t first[257]; //! The index in entries of the first deliminator starting with each byte.
+		ByteSet firstBytes; //! The bytes deliminators start with.
+		TokenClassifier classifier; //! The taggers fused into one classifier.
+
+	public:
+		BooleanLiteralTagger boolTag; //! The boolean tag parser.
+		IntegerLiteralTagger intTag; //! The int tag parser.
+		FloatingLiteralTagger floatTag; //! The float tag parser.
+		CharacterLiteralTagger charTag; //! The character tag parser.
+		StringLiteralTagger stringTag; //! The string tag parser.
+		SymbolTagger symbolTag; //! The symbol tag parser.
+		KeywordTable keywords; //! The keywords tokens are given ids from; see Lexer::keyword.
+
+		/*! \brief Constructor.
+		 * Initializes the lexer.
+		 */
+		StaticLexer()
+		{
+			std::vector<std::pair<unsigned char, Entry> > v;
+			Compiler<0, D...>::compile(v);
+
+			// Longest start points first; for equal ones the last declared wins, as in Lexer.
+			std::stable_sort(v.begin(), v.end(), [](const std::pair<unsigned char, Entry> &a, const std::pair<unsigned char, Entry> &b)
+			{
+				if (a.first != b.first)
+					return a.first < b.first;
+				if (a.second.size != b.second.size)
+					return a.second.size > b.second.size;
+				return a.second.order > b.second.order;
+			});
+
+			size_t j = 0;
+			for (int i = 0; i < 256; i++)
+			{
+				first[i] = entries.size();
+				for (; j < v.size() && v[j].first == i; j++)
+				{
+					entries.push_back(v[j].second);
+					firstBytes.insert((unsigned char)i);
+				}
+			}
+			first[256] = entries.size();
+		}
+
+		/*! \brief Gives a Lexer the deliminators of the grammar, in the same order.
+		 * The Lexer then lexes input to the same tokens as the StaticLexer, so the grammar only needs to be
+		 * spelled out once where both are wanted.
+		 */
+		static void deliminate(Lexer &l)
+		{
+			Compiler<0, D...>::deliminate(l);
+		}
+
+		/*! \brief Hashes the lexical grammar.
+		 * Covers the deliminators, the tagger settings and the keywords: two lexers with the same fingerprint
+		 * lex any input to the same tokens.
+		 */
+		uint64_t fingerprint() const
+		{
+			return hashBytes(NULL, 0, Compiler<0, D...>::fingerprint() ^ TokenClassifier::fingerprint(symbolTag, boolTag, charTag, stringTag, floatTag) ^ keywords.fingerprint());
+		}
+
+		/*! \brief Performs the actual lexical analysis on a source buffer.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \aaram coloff The starting column number (from 0), -1 if none.
+		 * \returns The resultant token vector.
+		 */
+		std::vector<Token> lex(std::shared_ptr<const SourceBuffer> b, ErrorHandler &, int lineoff = -1, int columnoff = -1)
+		{
+			std::vector<Token> rtn;
+			SourceTable::FileId f = SourceTable::global().add(b, (lineoff > 1 ? lineoff : 1), (columnoff > 0 ? columnoff : 0));
+			classifier.update(symbolTag, boolTag, charTag, stringTag, floatTag);
+
+			const char *s = b->data();
+			size_t n = b->size();
+			size_t last = 0;
+
+			for (size_t i = 0; i < n; i++)
+			{
+				unsigned char c = s[i];
+				if (first[c] == first[c+1])
+				{
+					i = firstBytes.find(s+i, s+n)-s;
+					if (i >= n)
+						break;
+					c = s[i];
+				}
+				size_t dl = 0;
+				bool filtered = false;
+				for (size_t k = first[c]; k < first[c+1]; k++)
+				{
+					const Entry &e = entries[k];
+					if (e.size <= n-i && e.matches(s+i))
+					{
+						dl = e.extent(s+i, s+n, filtered);
+						break;
+					}
+				}
+
+				if (dl == 0)
+					continue;
+
+				if (last < i)
+				{
+					StringRef v(s+last, i-last);
+					rtn.push_back(Token(f, last, i-last, classifier.classify(v), false, keywords.find(v)));
+				}
+
+				rtn.push_back(Token(f, i, dl, DeliminatorTag, filtered, keywords.find(StringRef(s+i, dl))));
+				i += dl-1;
+				last = i+1;
+			}
+
+			if (last < n)
+			{
+				StringRef v(s+last, n-last);
+				rtn.push_back(Token(f, last, n-last, classifier.classify(v), false, keywords.find(v)));
+			}
+
+			return rtn;
+		}
+
+		/*! \brief Performs the actual lexical analysis.
+		 * \param s The input string.
+		 * \param f The input file name.
+		 * \param eh The error handler.
+		 * \returns The resultant token vector.
+		 */
+		std::vector<Token> lex(std::string s, std::string f, ErrorHandler &eh)
+		{
+			return lex(SourceBuffer::fromString(s, f), eh);
+		}
+	};
+}
+
+#endif
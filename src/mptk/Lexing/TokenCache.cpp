@@ -0,0 +1,339 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "TokenCache.h"
+#include "../Core/Utils.h"
+
+#include <unordered_map>
+#include <cstdio>
+#include <cstring>
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace mitten
+{
+	/* An entry is the magic bytes, the format version, the source size, the source hash and the grammar
+	 * fingerprint, then the string table (a count, then each string's length and bytes) and the tokens (a
+	 * count, then one varint head per token). The low bits of the head are the tag, the filtered bit and
+	 * the owned bit. An owned token's head carries its value's string index, and is followed by the index
+	 * of its file path, its line and its column. Any other token's head carries its length and bits saying
+	 * whether a zigzag-encoded delta from the end of the previous token follows, and then whether a keyword
+	 * id follows.
+	 */
+	static const char Magic[4] = {'M', 'T', 'K', 'C'};
+
+	string TokenCache::entryPath(uint64_t content, uint64_t grammar) const
+	{
+		char name[64];
+		snprintf(name, sizeof(name), "/%016llx-%016llx.tokens", (unsigned long long)content, (unsigned long long)grammar);
+		return directory+name;
+	}
+
+	void TokenCache::putVarint(string &out, uint64_t v)
+	{
+		while (v >= 0x80)
+		{
+			out.push_back((char)(v | 0x80));
+			v >>= 7;
+		}
+		out.push_back((char)v);
+	}
+
+	bool TokenCache::getVarint(const char *&p, const char *e, uint64_t &v)
+	{
+		if (p < e && (*p & 0x80) == 0)
+		{
+			v = (unsigned char)*p++;
+			return true;
+		}
+
+		v = 0;
+		for (int shift = 0; p < e && shift < 64; shift += 7)
+		{
+			unsigned char c = *p++;
+			v |= (uint64_t)(c & 0x7F) << shift;
+			if ((c & 0x80) == 0)
+				return true;
+		}
+		return false;
+	}
+
+	TokenCache::TokenCache(string d) : directory(d), hits(0), misses(0)
+	{
+		mkdir(directory.c_str(), 0777);
+	}
+
+	bool TokenCache::load(shared_ptr<const SourceBuffer> b, uint64_t grammar, vector<Token> &rtn, int lineoff, int columnoff)
+	{
+		uint64_t content = hashBytes(b->data(), b->size());
+		string path = entryPath(content, grammar);
+		if (SourceBuffer::fileSize(path) < (long)sizeof(Magic))
+			return false;
+
+		shared_ptr<const SourceBuffer> entry;
+		try
+		{
+			entry = SourceBuffer::fromFile(path);
+		}
+		catch (runtime_error &e)
+		{
+			return false;
+		}
+
+		const char *p = entry->data();
+		const char *e = p+entry->size();
+		uint64_t version, size, storedContent, storedGrammar;
+		if (entry->size() < sizeof(Magic)+16 || memcmp(p, Magic, sizeof(Magic)) != 0)
+			return false;
+		p += sizeof(Magic);
+		if (!getVarint(p, e, version) || version != Version || !getVarint(p, e, size) || size != b->size() || e-p < 16)
+			return false;
+		memcpy(&storedContent, p, 8);
+		memcpy(&storedGrammar, p+8, 8);
+		p += 16;
+		if (storedContent != content || storedGrammar != grammar)
+			return false;
+
+		uint64_t count;
+		if (!getVarint(p, e, count) || count > (uint64_t)(e-p))
+			return false;
+		vector<string> strings;
+		strings.reserve(count);
+		for (uint64_t i = 0; i < count; i++)
+		{
+			uint64_t n;
+			if (!getVarint(p, e, n) || n > (uint64_t)(e-p))
+				return false;
+			strings.push_back(string(p, n));
+			p += n;
+		}
+
+		if (!getVarint(p, e, count) || count > (uint64_t)(e-p))
+			return false;
+
+		// Tokens need the buffer's file id, so it is added before they are read and removed again if they are bad.
+		SourceTable::FileId f = SourceTable::global().add(b, (lineoff > 1 ? lineoff : 1), (columnoff > 0 ? columnoff : 0));
+		size_t start = rtn.size();
+		rtn.reserve(start+count);
+
+		uint64_t last = 0;
+		for (uint64_t i = 0; i < count; i++)
+		{
+			uint64_t head;
+			if (!getVarint(p, e, head))
+				break;
+
+			TokenTag t = (TokenTag)(head & 0x07);
+			bool filtered = (head & 0x08) != 0;
+			if (head & 0x10)
+			{
+				uint64_t file, line, column;
+				if ((head >> 5) >= strings.size() || !getVarint(p, e, file) || file >= strings.size() || !getVarint(p, e, line) || !getVarint(p, e, column))
+					break;
+				rtn.push_back(Token(strings[head >> 5], strings[file], (int)line, (int)column, t, filtered));
+			}
+			else
+			{
+				uint64_t delta = 0, keyword = 0;
+				if ((head & 0x20) && !getVarint(p, e, delta))
+					break;
+				if ((head & 0x40) && (!getVarint(p, e, keyword) || keyword > 0xFFFF))
+					break;
+				uint64_t offset = last+((delta & 1) ? ~(delta >> 1) : (delta >> 1));
+				uint64_t length = head >> 7;
+				if (offset > b->size() || length > b->size()-offset)
+					break;
+				rtn.push_back(Token(f, (uint32_t)offset, (uint32_t)length, t, filtered, (uint16_t)keyword));
+				last = offset+length;
+			}
+		}
+
+		if (rtn.size()-start != count || p != e)
+		{
+			rtn.resize(start);
+			SourceTable::global().remove(f);
+			return false;
+		}
+		return true;
+	}
+
+	bool TokenCache::store(shared_ptr<const SourceBuffer> b, uint64_t grammar, const vector<Token> &tokens)
+	{
+		SourceTable &table = SourceTable::global();
+		vector<StringRef> strings;
+		unordered_map<string, uint64_t> stringIds;
+		auto stringId = [&](StringRef s) -> uint64_t
+		{
+			auto i = stringIds.insert(make_pair(s.str(), (uint64_t)strings.size()));
+			if (i.second)
+				strings.push_back(StringRef(i.first->first));
+			return i.first->second;
+		};
+
+		string body;
+		body.reserve(tokens.size()*3);
+		uint64_t last = 0;
+		SourceTable::FileId known = 0;
+		bool matched = false;
+		for (auto &i : tokens)
+		{
+			uint64_t bits = (uint64_t)i.tag() | (i.filtered() ? 0x08 : 0);
+			if (i.owned())
+			{
+				putVarint(body, (stringId(i.view()) << 5) | bits | 0x10);
+				putVarint(body, stringId(i.file()));
+				putVarint(body, (uint64_t)i.line());
+				putVarint(body, (uint64_t)i.column());
+			}
+			else
+			{
+				if (!matched || i.fileId() != known)
+				{
+					if (table.buffer(i.fileId()) != b)
+						return false;
+					known = i.fileId();
+					matched = true;
+				}
+
+				// Lexed tokens are usually contiguous, in which case the delta is left out.
+				int64_t delta = (int64_t)i.offset()-(int64_t)last;
+				putVarint(body, ((uint64_t)i.length() << 7) | bits | (delta != 0 ? 0x20 : 0) | (i.keyword() != 0 ? 0x40 : 0));
+				if (delta != 0)
+					putVarint(body, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+				if (i.keyword() != 0)
+					putVarint(body, i.keyword());
+				last = i.offset()+i.length();
+			}
+		}
+
+		uint64_t content = hashBytes(b->data(), b->size());
+		string out(Magic, sizeof(Magic));
+		putVarint(out, Version);
+		putVarint(out, b->size());
+		out.append((const char *)&content, 8);
+		out.append((const char *)&grammar, 8);
+		putVarint(out, strings.size());
+		for (auto &i : strings)
+		{
+			putVarint(out, i.size());
+			out.append(i.data(), i.size());
+		}
+		putVarint(out, tokens.size());
+		out += body;
+
+		// Written under a unique temporary name first, so that concurrent readers never see a partial entry.
+		string path = entryPath(content, grammar);
+		vector<char> tmp(path.begin(), path.end());
+		const char suffix[] = ".XXXXXX";
+		tmp.insert(tmp.end(), suffix, suffix+sizeof(suffix));
+		int fd = mkstemp(tmp.data());
+		if (fd < 0)
+			return false;
+		fchmod(fd, 0644);
+
+		bool written = true;
+		for (size_t n = 0; written && n < out.size(); )
+		{
+			ssize_t w = write(fd, out.data()+n, out.size()-n);
+			written = (w > 0);
+			n += (written ? (size_t)w : 0);
+		}
+		if (close(fd) != 0 || !written || rename(tmp.data(), path.c_str()) != 0)
+		{
+			remove(tmp.data());
+			return false;
+		}
+		return true;
+	}
+
+	void TokenCache::CountingErrorHandler::mismatchedStructureBounds(Token source, string start, string end)
+	{
+		count++;
+		target.mismatchedStructureBounds(source, start, end);
+	}
+
+	void TokenCache::CountingErrorHandler::incompleteStructureBound(Token source, string start, string end)
+	{
+		count++;
+		target.incompleteStructureBound(source, start, end);
+	}
+
+	void TokenCache::CountingErrorHandler::unexpectedArgumentList(Token source)
+	{
+		count++;
+		target.unexpectedArgumentList(source);
+	}
+
+	void TokenCache::CountingErrorHandler::expectedExpression(Token source)
+	{
+		count++;
+		target.expectedExpression(source);
+	}
+
+	void TokenCache::CountingErrorHandler::operationRequiredLeftOperand(Token source)
+	{
+		count++;
+		target.operationRequiredLeftOperand(source);
+	}
+
+	void TokenCache::CountingErrorHandler::unexpectedTokenInExpression(Token source)
+	{
+		count++;
+		target.unexpectedTokenInExpression(source);
+	}
+
+	void TokenCache::CountingErrorHandler::cannotOperateOnAnOperator(Token source)
+	{
+		count++;
+		target.cannotOperateOnAnOperator(source);
+	}
+
+	void TokenCache::CountingErrorHandler::macroAlreadyDefined(Token source)
+	{
+		count++;
+		target.macroAlreadyDefined(source);
+	}
+
+	void TokenCache::CountingErrorHandler::useOfUndefinedMacro(Token source)
+	{
+		count++;
+		target.useOfUndefinedMacro(source);
+	}
+}
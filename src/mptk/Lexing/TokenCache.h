@@ -0,0 +1,180 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef __MITTEN_TOKEN_CACHE_H
+#define __MITTEN_TOKEN_CACHE_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "../Core/Token.h"
+#include "../Core/SourceBuffer.h"
+#include "../Core/ErrorHandler.h"
+
+namespace mitten
+{
+	/*! \brief An on-disk cache of lexed token vectors.
+	 * Entries are keyed by a hash of the source contents and the fingerprint of the lexical grammar, so
+	 * an unchanged file lexed with an unchanged grammar is loaded instead of lexed again, even by another
+	 * process. Tokens are stored compactly: positions as deltas from the end of the previous token, lengths
+	 * as varints, and the values of tokens which own them (macro expansions) in a table of unique strings.
+	 * Loading an entry gives a token vector identical to the one stored. Entries which cannot be read or
+	 * do not match the source are treated as misses and replaced. Lexes which reported errors are not
+	 * stored, since the errors could not be reported again on a hit.
+	 */
+	class TokenCache
+	{
+	protected:
+		static const uint64_t Version = 2; //! The version of the entry format.
+
+		std::string directory; //! The directory entries are stored in.
+
+		/*! \brief Gets the path of the entry for a source hash and grammar fingerprint. */
+		std::string entryPath(uint64_t content, uint64_t grammar) const;
+
+		/*! \brief Appends an unsigned LEB128 varint to a string. */
+		static void putVarint(std::string &out, uint64_t v);
+
+		/*! \brief Reads an unsigned LEB128 varint, advancing \p p.
+		 * \returns False if the varint runs past \p e.
+		 */
+		static bool getVarint(const char *&p, const char *e, uint64_t &v);
+
+		/*! \brief Helper method.
+		 * Checks whether a lexer runs callbacks, whose effects a cache hit could not repeat and which the
+		 * fingerprint does not cover. Lexers without a hasCallbacks() method run none.
+		 */
+		template <typename L> static auto hasCallbacks(L &lexer, int) -> decltype(lexer.hasCallbacks())
+		{
+			return lexer.hasCallbacks();
+		}
+
+		template <typename L> static bool hasCallbacks(L &, long)
+		{
+			return false;
+		}
+
+		/*! \brief Helper class.
+		 * Passes errors on to another error handler, counting them.
+		 */
+		class CountingErrorHandler : public ErrorHandler
+		{
+		public:
+			ErrorHandler &target; //! The error handler errors are passed on to.
+			size_t count; //! The number of errors passed on.
+
+			CountingErrorHandler(ErrorHandler &t) : target(t), count(0) {}
+
+			virtual void mismatchedStructureBounds(Token source, std::string start, std::string end);
+			virtual void incompleteStructureBound(Token source, std::string start, std::string end);
+			virtual void unexpectedArgumentList(Token source);
+			virtual void expectedExpression(Token source);
+			virtual void operationRequiredLeftOperand(Token source);
+			virtual void unexpectedTokenInExpression(Token source);
+			virtual void cannotOperateOnAnOperator(Token source);
+			virtual void macroAlreadyDefined(Token source);
+			virtual void useOfUndefinedMacro(Token source);
+		};
+
+	public:
+		size_t hits; //! The number of token vectors loaded from the cache.
+		size_t misses; //! The number of token vectors which had to be lexed.
+
+		/*! \brief Constructor.
+		 * Creates the directory if it does not exist yet.
+		 * \param d The directory to store entries in.
+		 */
+		TokenCache(std::string d);
+
+		/*! \brief Loads the tokens lexed from a source buffer.
+		 * On success the buffer is added to the source table, as lexing it would.
+		 * \param b The source buffer.
+		 * \param grammar The fingerprint of the lexical grammar.
+		 * \param rtn The token vector to append to.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \param columnoff The starting column number (from 0), -1 if none.
+		 * \returns False if there is no usable entry.
+		 */
+		bool load(std::shared_ptr<const SourceBuffer> b, uint64_t grammar, std::vector<Token> &rtn, int lineoff = -1, int columnoff = -1);
+
+		/*! \brief Stores the tokens lexed from a source buffer.
+		 * Tokens which view a buffer other than \p b cannot be stored, since their buffer is not known to
+		 * later processes.
+		 * \param b The source buffer.
+		 * \param grammar The fingerprint of the lexical grammar.
+		 * \param tokens The tokens lexed from \p b.
+		 * \returns False if the tokens could not be stored.
+		 */
+		bool store(std::shared_ptr<const SourceBuffer> b, uint64_t grammar, const std::vector<Token> &tokens);
+
+		/*! \brief Lexes a source buffer through the cache.
+		 * Works with any lexer with a fingerprint() method, such as Lexer or StaticLexer. Since the
+		 * fingerprint does not cover callbacks, a lexer with an onToken callback or deliminator pattern
+		 * callbacks always lexes and never touches the cache.
+		 * \param lexer The lexer to use on a miss.
+		 * \param b The input source buffer.
+		 * \param eh The error handler.
+		 * \param lineoff The starting line number (from 1), -1 if none.
+		 * \param columnoff The starting column number (from 0), -1 if none.
+		 * \returns The resultant token vector.
+		 */
+		template <typename L> std::vector<Token> lex(L &lexer, std::shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff = -1, int columnoff = -1)
+		{
+			if (hasCallbacks(lexer, 0))
+				return lexer.lex(b, eh, lineoff, columnoff);
+
+			uint64_t grammar = lexer.fingerprint();
+			std::vector<Token> rtn;
+			if (load(b, grammar, rtn, lineoff, columnoff))
+			{
+				hits++;
+				return rtn;
+			}
+
+			misses++;
+			CountingErrorHandler counted(eh);
+			rtn = lexer.lex(b, counted, lineoff, columnoff);
+			if (counted.count == 0)
+				store(b, grammar, rtn);
+			return rtn;
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,92 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_TOKEN_SINK_H
+#define __MITTEN_TOKEN_SINK_H
+
+#include <iostream>
+#include <vector>
+#include <functional>
+
+#include "../Core/Token.h"
+#include "../Core/ErrorHandler.h"
+
+namespace mitten
+{
+	/*! \brief Receives lexed tokens in batches.
+	 * Subclass this to filter, rewrite or forward tokens as they are lexed with one virtual call per
+	 * batch rather than per token. For sinks known at compile time, see Lexer::lexTo.
+	 */
+	class TokenSink
+	{
+	public:
+		static const size_t BatchSize = 256; //! The largest number of tokens in a batch.
+
+		virtual ~TokenSink() {}
+
+		/*! \brief Receives the next batch of tokens.
+		 * \param t The tokens, valid only for the duration of the call.
+		 * \param n The number of tokens.
+		 * \param eh The error handler.
+		 */
+		virtual void consume(const Token *t, size_t n, ErrorHandler &eh) = 0;
+
+		/*! \brief Called once after the last batch. */
+		virtual void finish(ErrorHandler &) {}
+	};
+
+	/*! \brief Runs an onToken-style callback on each token of a batch.
+	 * Lets existing Lexer::onToken callbacks be used with the batch interface.
+	 */
+	class CallbackTokenSink : public TokenSink
+	{
+	protected:
+		std::function<void (Token, std::vector<Token> &, ErrorHandler &)> callback; //! The callback, appends to tokens if empty.
+
+	public:
+		std::vector<Token> tokens; //! The token vector handed to the callback.
+
+		/*! \brief Constructor.
+		 * \param c The callback.
+		 */
+		CallbackTokenSink(std::function<void (Token, std::vector<Token> &, ErrorHandler &)> c) : callback(c) {}
+
+		void consume(const Token *t, size_t n, ErrorHandler &eh);
+	};
+}
+
+#endif
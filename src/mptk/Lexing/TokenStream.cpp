@@ -0,0 +1,182 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "TokenStream.h"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+using namespace std;
+
+namespace mitten
+{
+	TokenStream::TokenStream(Lexer &l, ChunkReader r, string p, ErrorHandler &e) : lexer(l.state()), eh(e), reader(r), path(p), line(1), column(0), ended(false), released(false), previous(0), searched(0), retainInput(true)
+	{
+	}
+
+	TokenStream::TokenStream(Lexer &l, istream &in, string p, ErrorHandler &e, size_t chunk) : TokenStream(l, ChunkReader(), p, e)
+	{
+		reader = [&in, chunk](string &s)
+		{
+			s.resize(chunk);
+			in.read(&s[0], chunk);
+			s.resize(in.gcount());
+			return !s.empty();
+		};
+	}
+
+	TokenStream::TokenStream(Lexer &l, int fd, string p, ErrorHandler &e, size_t chunk) : TokenStream(l, ChunkReader(), p, e)
+	{
+		reader = [fd, chunk, p](string &s)
+		{
+			s.resize(chunk);
+			ssize_t n;
+			do
+			{
+				n = ::read(fd, &s[0], chunk);
+			} while (n < 0 && errno == EINTR);
+
+			if (n < 0)
+				throw runtime_error("cannot read from "+p+": "+strerror(errno));
+			s.resize(n);
+			return n > 0;
+		};
+	}
+
+	TokenStream::TokenStream(Lexer &l, vector<string> c, string p, ErrorHandler &e) : TokenStream(l, ChunkReader(), p, e)
+	{
+		size_t n = 0;
+		reader = [c, n](string &s) mutable
+		{
+			if (n >= c.size())
+				return false;
+			s = c[n++];
+			return true;
+		};
+	}
+
+	void TokenStream::fill()
+	{
+		while (tokens.empty() && !(ended && window.empty()))
+		{
+			if (!ended)
+			{
+				string tmp;
+				if (reader(tmp))
+					window += tmp;
+				else
+					ended = true;
+			}
+
+			if (window.empty())
+				continue;
+
+			// Rescanning a window which stopped inside a deliminator is pointless until its end-point arrives.
+			if (!awaiting.empty() && !ended)
+			{
+				if (window.find(awaiting, searched) == string::npos)
+				{
+					if (window.size() >= awaiting.size())
+						searched = window.size()-awaiting.size()+1;
+					continue;
+				}
+				awaiting.clear();
+			}
+
+			if (released)
+			{
+				SourceTable::global().remove(previous);
+				released = false;
+			}
+
+			SourceTable::FileId f = SourceTable::global().add(SourceBuffer::fromString(window, path), line, column);
+			vector<Token> rtn;
+			CompiledGrammar::PendingEnd pending;
+			size_t n = lexer.scan(window, f, ended, rtn, eh, &pending);
+			if (pending.end != NULL)
+			{
+				awaiting = *pending.end;
+				searched = pending.from-n;
+			}
+
+			if (n == 0)
+			{
+				SourceTable::global().remove(f);
+				continue;
+			}
+
+			for (size_t i = 0; i < n; i++)
+			{
+				if (window[i] == '\n')
+				{
+					line++;
+					column = 0;
+				}
+				else
+				{
+					column++;
+				}
+			}
+
+			window.erase(0, n);
+			tokens.insert(tokens.end(), rtn.begin(), rtn.end());
+			previous = f;
+			released = !retainInput;
+		}
+	}
+
+	bool TokenStream::empty()
+	{
+		fill();
+		return tokens.empty();
+	}
+
+	Token TokenStream::peek()
+	{
+		if (empty())
+			throw runtime_error("token stream is empty");
+		return tokens.front();
+	}
+
+	Token TokenStream::next()
+	{
+		Token rtn = peek();
+		tokens.pop_front();
+		return rtn;
+	}
+}
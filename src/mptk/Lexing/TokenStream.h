@@ -0,0 +1,150 @@
+/******************************************************************************
+ *                                 _ _   _                                    *
+ *                           /\/\ (_) |_| |_ ___ _ __                         *
+ *                          /    \| | __| __/ _ \ '_ \                        *
+ *                         / /\/\ \ | |_| ||  __/ | | |                       *
+ *                         \/    \/_|\__|\__\___|_| |_|                       *
+ *                                                                            *
+ ******************************************************************************/
+
+/*
+ * Copyright (c) 2014, Oliver Katz
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice, 
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright notice, 
+ * this list of conditions and the following disclaimer in the documentation 
+ * and/or other materials provided with the distribution.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE 
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE 
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE 
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR 
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF 
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS 
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN 
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE 
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef __MITTEN_TOKEN_STREAM_H
+#define __MITTEN_TOKEN_STREAM_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "Lexer.h"
+
+namespace mitten
+{
+	/*! \brief Lexes input incrementally, handing out one token at a time.
+	 * The input is read in chunks. Each chunk, along with whatever text was left over from the
+	 * previous one, is lexed as a window registered in the source table with the line and column
+	 * it starts at, so the resultant tokens carry the same values and positions as if the whole
+	 * input had been lexed at once. Text at the end of a window which more input could still change
+	 * (an unterminated deliminator, a prefix of a longer deliminator, or an undelimited run) is
+	 * carried over into the next window. The lexer must outlive the stream and must not be
+	 * reconfigured while the stream is in use.
+	 */
+	class TokenStream
+	{
+	public:
+		/*! \brief Reads the next chunk of input into the string given.
+		 * \returns False if the end of the input has been reached.
+		 */
+		typedef std::function<bool (std::string &)> ChunkReader;
+
+	protected:
+		LexerState lexer; //! The state lexed with, against the lexer's grammar as it was when the stream was created.
+		ErrorHandler &eh; //! The error handler.
+		ChunkReader reader; //! The input.
+		std::string path; //! The file path given to the windows.
+		std::string window; //! The input not yet lexed.
+		std::deque<Token> tokens; //! The tokens lexed but not yet handed out.
+		int line; //! The line number of the start of the window.
+		int column; //! The column number of the start of the window.
+		bool ended; //! Whether the end of the input has been read.
+		bool released; //! Whether the previous window is to be removed from the source table.
+		SourceTable::FileId previous; //! The file id of the previous window.
+		std::string awaiting; //! The end-point the window stopped to wait for, empty if none.
+		size_t searched; //! The offset in the window from which awaiting has yet to be searched for.
+
+		/*! \brief Lexes windows until a token is available or the input is exhausted.
+		 */
+		void fill();
+
+	public:
+		/*! \brief Whether the values of tokens from earlier windows are kept.
+		 * Defaults to true, in which case memory is NOT bounded: the text of every window stays in
+		 * the source table, as the values of the tokens handed out still refer to it. Set it to false
+		 * to keep memory bounded when every token is done with by the time the next one is requested;
+		 * each window is then removed from the source table once its tokens have all been handed out,
+		 * and reading a token of a removed window throws a runtime_error.
+		 */
+		bool retainInput;
+
+		/*! \brief Constructor.
+		 * Creates a stream reading chunks from a callback.
+		 * \param l The lexer.
+		 * \param r The chunk reader.
+		 * \param p The file path.
+		 * \param e The error handler.
+		 */
+		TokenStream(Lexer &l, ChunkReader r, std::string p, ErrorHandler &e);
+
+		/*! \brief Constructor.
+		 * Creates a stream reading from an input stream.
+		 * \param l The lexer.
+		 * \param in The input stream.
+		 * \param p The file path.
+		 * \param e The error handler.
+		 * \param chunk The size of each read.
+		 */
+		TokenStream(Lexer &l, std::istream &in, std::string p, ErrorHandler &e, size_t chunk = 65536);
+
+		/*! \brief Constructor.
+		 * Creates a stream reading from a file descriptor.
+		 * \param l The lexer.
+		 * \param fd The file descriptor.
+		 * \param p The file path.
+		 * \param e The error handler.
+		 * \param chunk The size of each read.
+		 */
+		TokenStream(Lexer &l, int fd, std::string p, ErrorHandler &e, size_t chunk = 65536);
+
+		/*! \brief Constructor.
+		 * Creates a stream over a sequence of chunks.
+		 * \param l The lexer.
+		 * \param c The chunks.
+		 * \param p The file path.
+		 * \param e The error handler.
+		 */
+		TokenStream(Lexer &l, std::vector<std::string> c, std::string p, ErrorHandler &e);
+
+		/*! \brief Checks whether there are no tokens left. */
+		bool empty();
+
+		/*! \brief Gets the next token without consuming it.
+		 * Throws if there are no tokens left.
+		 */
+		Token peek();
+
+		/*! \brief Consumes the next token.
+		 * Throws if there are no tokens left.
+		 */
+		Token next();
+	};
+}
+
+#endif
@@ -43,8 +43,19 @@
 #define MPTK_VERSION 0x001
 
 #include "Core/Utils.h"
+#include "Core/StringRef.h"
+#include "Core/SourceBuffer.h"
+#include "Core/LineIndex.h"
+#include "Core/SourceTable.h"
 #include "Core/Token.h"
+#include "Lexing/KeywordTable.h"
+#include "Lexing/CompiledGrammar.h"
+#include "Lexing/LexerState.h"
 #include "Lexing/Lexer.h"
+#include "Lexing/TokenStream.h"
+#include "Lexing/StaticLexer.h"
+#include "Lexing/TokenCache.h"
+#include "Lexing/ModalLexer.h"
 #include "Core/AST.h"
 #include "Core/ErrorHandler.h"
 #include "Parsing/StructureParser.h"
@@ -156,7 +156,7 @@ namespace mitten
 		operators[o] = OperatorInfo(false, false, false, p);
 	}
 
-	bool ExpressionParser::isExpression(AST a)
+	bool ExpressionParser::isExpression(AST &a)
 	{
 		if (a.isBranch())
 			return (a.name().compare(expressionBound) == 0);
@@ -164,7 +164,7 @@ namespace mitten
 			return false;
 	}
 
-	bool ExpressionParser::isExpressionElement(AST a)
+	bool ExpressionParser::isExpressionElement(AST &a)
 	{
 		if (a.isBranch())
 			return (a.name().compare(expressionElement) == 0);
@@ -172,7 +172,7 @@ namespace mitten
 			return false;
 	}
 
-	bool ExpressionParser::isLiteral(AST a)
+	bool ExpressionParser::isLiteral(AST &a)
 	{
 		if (a.isLeaf())
 			return isLiteral(a.leaf().value());
@@ -180,7 +180,7 @@ namespace mitten
 			return false;
 	}
 
-	bool ExpressionParser::isSymbol(AST a)
+	bool ExpressionParser::isSymbol(AST &a)
 	{
 		if (a.isLeaf())
 			return isSymbol(a.leaf().value());
@@ -188,7 +188,7 @@ namespace mitten
 			return false;
 	}
 
-	bool ExpressionParser::isOperator(AST a)
+	bool ExpressionParser::isOperator(AST &a)
 	{
 		if (a.isLeaf())
 			return (operators.find(a.leaf().value()) != operators.end());
@@ -196,7 +196,7 @@ namespace mitten
 			return false;
 	}
 
-	int ExpressionParser::getPrecedenceOfNode(AST a)
+	int ExpressionParser::getPrecedenceOfNode(AST &a)
 	{
 		int ptmp = MITTEN_MAX_PRECEDENCE;
 		if (a.isBranch())
@@ -227,7 +227,7 @@ namespace mitten
 
 		for (int i = 0; i < ast.size(); i++)
 		{
-			AST a = ast[i];
+			AST &a = ast[i];
 			AST value;
 
 			if (isExpression(a) || isLiteral(a) || isSymbol(a))
@@ -105,12 +105,12 @@ namespace mitten
 		 */
 		virtual bool isLiteral(std::string s);
 
-		bool isExpression(AST a);
-		bool isExpressionElement(AST a);
-		bool isLiteral(AST a);
-		bool isSymbol(AST a);
-		bool isOperator(AST a);
-		int getPrecedenceOfNode(AST a);
+		bool isExpression(AST &a);
+		bool isExpressionElement(AST &a);
+		bool isLiteral(AST &a);
+		bool isSymbol(AST &a);
+		bool isOperator(AST &a);
+		int getPrecedenceOfNode(AST &a);
 		
 
 	public:
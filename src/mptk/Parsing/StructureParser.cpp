@@ -36,17 +36,94 @@
 
 #include "StructureParser.h"
 
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+
 using namespace std;
 
 namespace mitten
 {
+	const size_t StructureParser::Unmatched;
+
+	/* An error handler which records the errors reported to it on a worker thread of parseParallel, to
+	 * report them to the parser's error handler afterwards, in source order.
+	 */
+	class DeferredErrorHandler : public ErrorHandler
+	{
+	protected:
+		vector<function<void (ErrorHandler &)> > errors;
+
+	public:
+		virtual void mismatchedStructureBounds(Token source, string start, string end)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.mismatchedStructureBounds(source, start, end); });
+		}
+
+		virtual void incompleteStructureBound(Token source, string start, string end)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.incompleteStructureBound(source, start, end); });
+		}
+
+		virtual void unexpectedArgumentList(Token source)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.unexpectedArgumentList(source); });
+		}
+
+		virtual void expectedExpression(Token source)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.expectedExpression(source); });
+		}
+
+		virtual void operationRequiredLeftOperand(Token source)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.operationRequiredLeftOperand(source); });
+		}
+
+		virtual void unexpectedTokenInExpression(Token source)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.unexpectedTokenInExpression(source); });
+		}
+
+		virtual void cannotOperateOnAnOperator(Token source)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.cannotOperateOnAnOperator(source); });
+		}
+
+		virtual void macroAlreadyDefined(Token source)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.macroAlreadyDefined(source); });
+		}
+
+		virtual void useOfUndefinedMacro(Token source)
+		{
+			errors.push_back([=](ErrorHandler &e) { e.useOfUndefinedMacro(source); });
+		}
+
+		void replay(ErrorHandler &e)
+		{
+			for (auto &i : errors)
+				i(e);
+			errors.clear();
+		}
+	};
+
 	StructureParser::Bound &StructureParser::Bound::setEndIsParentSplit(bool v)
 	{
 		endIsParentSplit = v;
 		return *this;
 	}
 
-	StructureParser::StructureParser(string en, string sp)
+	StructureParser::Bound &StructureParser::Bound::setLazy(bool v)
+	{
+		lazy = v;
+		return *this;
+	}
+
+	StructureParser::StructureParser(string en, string sp) : kindsNeedLookup(true), compiled(false), hasLazyBounds(false)
 	{
 		globalBoundName = en;
 		globalSplitName = sp;
@@ -54,11 +131,18 @@ namespace mitten
 
 	StructureParser::Bound &StructureParser::bind(string n, string st, string e, string en, string sp)
 	{
+		if (bounds.find(st) == bounds.end())
+			boundOrder.push_back(st);
 		bounds[st] = Bound(n, e, en, sp);
-		boundEnds.insert(e);
+		compiled = false;
 		return bounds[st];
 	}
 
+	StructureParser::Bound &StructureParser::bind(const KeywordTable &k, string n, KeywordId st, KeywordId e, string en, KeywordId sp)
+	{
+		return bind(n, k.name(st), k.name(e), en, (sp == NoKeyword ? "" : k.name(sp)));
+	}
+
 	void StructureParser::setGlobalBoundName(string n)
 	{
 		globalBoundName = n;
@@ -68,6 +152,90 @@ namespace mitten
 	{
 		globalSplitName = en;
 		globalSplitToken = sp;
+		compiled = false;
+	}
+
+	void StructureParser::setKeywords(const KeywordTable &k)
+	{
+		tokenKeywords = k;
+		compiled = false;
+	}
+
+	void StructureParser::compile()
+	{
+		kinds = KeywordTable();
+		boundTable.clear();
+		hasLazyBounds = false;
+		for (auto &i : boundOrder)
+		{
+			const Bound &b = bounds[i];
+			boundTable.push_back(b);
+			hasLazyBounds = hasLazyBounds || b.lazy;
+			kinds.add(i);
+			if (!b.end.empty())
+				kinds.add(b.end);
+			if (!b.split.empty())
+				kinds.add(b.split);
+		}
+		if (!globalSplitToken.empty())
+			kinds.add(globalSplitToken);
+
+		size_t width = kinds.size()+1;
+		transitions.assign((boundOrder.size()+1)*width, Transition());
+		for (size_t s = 0; s <= boundOrder.size(); s++)
+		{
+			const Bound *top = (s < boundOrder.size() ? &boundTable[s] : NULL);
+			for (size_t k = 1; k < width; k++)
+			{
+				const string &v = kinds.name((KeywordId)k);
+				Transition &t = transitions[s*width+k];
+				t.action = LeafAction;
+				t.bound = 0;
+
+				if (bounds.find(v) != bounds.end())
+				{
+					t.action = OpenAction;
+					t.bound = find(boundOrder.begin(), boundOrder.end(), v)-boundOrder.begin();
+				}
+				else if (top != NULL && v == top->end)
+				{
+					t.action = CloseAction;
+				}
+				else if (top != NULL && v == top->split)
+				{
+					t.action = SplitAction;
+				}
+				else if (top == NULL && v == globalSplitToken)
+				{
+					t.action = GlobalSplitAction;
+				}
+				else
+				{
+					for (size_t b = 0; b < boundTable.size(); b++)
+					{
+						if (v == boundTable[b].end)
+						{
+							t.action = MismatchAction;
+							t.bound = b;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		keywordKinds.assign(tokenKeywords.size()+1, 0);
+		kindsNeedLookup = false;
+		for (size_t k = 1; k < width; k++)
+		{
+			KeywordId id = tokenKeywords.find(kinds.name((KeywordId)k));
+			if (id == NoKeyword)
+				kindsNeedLookup = true;
+			else
+				keywordKinds[id] = (int)k;
+		}
+
+		compiled = true;
 	}
 	
 	void StructureParser::defineMacro(string s, AST v)
@@ -90,91 +258,576 @@ namespace mitten
 		return semanticMacros[s];
 	}
 
-	AST StructureParser::parse(vector<Token> toks, ErrorHandler &e)
+	void StructureParser::begin(ParseState &s)
 	{
-		ASTBuilder builder;
-		stack<string> boundStack;
+		if (!compiled)
+			compile();
 
 		if (!globalSplitToken.empty())
 		{
+			s.builder.append(AST::createNode(globalSplitName));
+			s.builder.descend();
+		}
+	}
+
+	void StructureParser::step(ParseState &s, const Token &i, ErrorHandler &e)
+	{
+		ErrorHandler &ne = (s.nodeErrors != NULL ? *s.nodeErrors : e);
+		if (!s.fed)
+		{
+			s.first = i;
+			s.fed = true;
+		}
+
+		if (i.filtered())
+			return;
+
+		ASTBuilder &builder = s.builder;
+		vector<uint32_t> &boundStack = s.boundStack;
+		uint32_t state = (boundStack.empty() ? (uint32_t)boundOrder.size() : boundStack.back());
+		const Transition &t = transitions[state*(kinds.size()+1)+kindOf(i)];
+
+		switch (t.action)
+		{
+		case OpenAction:
+		{
+			const Bound &b = boundTable[t.bound];
+			builder.append(AST::createNode(b.boundName));
+			builder.descend();
+			builder.append(AST::createNode(b.elementName));
+			builder.descend();
+			boundStack.push_back(t.bound);
+			break;
+		}
+		case CloseAction:
+		{
+			AST *head = &(builder.head());
+			builder.ascend();
+			builder.ascend();
+			boundStack.pop_back();
+			if (onNode)
+				onNode(builder.head(), builder, ne, *this);
+			if (!boundStack.empty() && (head->size() > 0 && boundTable[boundStack.back()].endIsParentSplit))
+			{
+				builder.append(AST::createNode(boundTable[boundStack.back()].elementName));
+				builder.descend();
+			}
+			break;
+		}
+		case SplitAction:
+			builder.ascend();
+			if (onNode)
+				onNode(builder.head(), builder, ne, *this);
+			builder.append(AST::createNode(boundTable[state].elementName));
+			builder.descend();
+			break;
+		case GlobalSplitAction:
+			builder.ascend();
+			if (onNode)
+				onNode(builder.head(), builder, ne, *this);
 			builder.append(AST::createNode(globalSplitName));
 			builder.descend();
+			break;
+		case MismatchAction:
+			e.mismatchedStructureBounds(i, boundOrder[t.bound], i.value());
+			break;
+		default:
+			builder.append(i);
+			if (onNode)
+				onNode(builder.head().rightmost(), builder, ne, *this);
+			break;
 		}
+	}
 
-		for (auto i : toks)
+	AST StructureParser::end(ParseState &s, ErrorHandler &e)
+	{
+		if (s.fed && s.boundStack.size() > 1)
 		{
-			if (i.filtered())
-				continue;
+			e.incompleteStructureBound(s.first, boundOrder[s.boundStack.back()], boundTable[s.boundStack.back()].end);
+		}
+
+		if (onNode)
+			onNode(s.builder.root(), s.builder, (s.nodeErrors != NULL ? *s.nodeErrors : e), *this);
+		return s.builder.root();
+	}
 
-			if (bounds.find(i.value()) != bounds.end())
+	size_t StructureParser::stepAt(ParseState &s, const vector<Token> &toks, size_t i, ErrorHandler &e)
+	{
+		const Token &t = toks[i];
+		if (!hasLazyBounds || t.filtered())
+		{
+			step(s, t, e);
+			return i+1;
+		}
+
+		uint32_t state = (s.boundStack.empty() ? (uint32_t)boundOrder.size() : s.boundStack.back());
+		const Transition &tr = transitions[state*(kinds.size()+1)+kindOf(t)];
+		if (tr.action != OpenAction || !boundTable[tr.bound].lazy)
+		{
+			step(s, t, e);
+			return i+1;
+		}
+
+		// The errors within the bound are only reported if it is skipped; otherwise it is parsed as usual.
+		DeferredErrorHandler errors;
+		bool filled = false;
+		size_t close = skipBound(toks, i, errors, filled);
+		if (close == Unmatched)
+		{
+			step(s, t, e);
+			return i+1;
+		}
+
+		if (!s.fed)
+		{
+			s.first = t;
+			s.fed = true;
+		}
+		errors.replay(e);
+
+		if (!s.source)
+			s.source = make_shared<const vector<Token> >(toks);
+		if (!s.parser)
+			s.parser = make_shared<StructureParser>(*this);
+		shared_ptr<StructureParser> p = s.parser;
+		shared_ptr<const vector<Token> > source = s.source;
+		uint32_t b = tr.bound;
+		ErrorHandler *handler = (s.expansionErrors != NULL ? s.expansionErrors : &e);
+		ASTBuilder &builder = s.builder;
+		builder.append(AST::createLazyNode(boundTable[b].boundName, source, i+1, close, [p, source, b, handler](AST &a, const vector<Token> &, size_t first, size_t last)
+		{
+			ParseState x;
+			x.source = source;
+			x.parser = p;
+			x.fed = true;
+			x.nodeErrors = handler;
+			x.expansionErrors = handler;
+			x.builder.append(AST::createNode(p->boundTable[b].boundName));
+			x.builder.descend();
+			x.builder.append(AST::createNode(p->boundTable[b].elementName));
+			x.builder.descend();
+			x.boundStack.push_back(b);
+
+			// Structural errors in the bound were reported when it was skipped; onNode reports to the handler of the parse.
+			InternalErrorHandler discarded;
+			for (size_t j = first; j < last; )
+				j = p->stepAt(x, *source, j, discarded);
+
+			AST &bound = x.builder.root()[0];
+			for (size_t j = 0; j < bound.size(); j++)
 			{
-				builder.append(AST::createNode(bounds[i.value()].boundName));
-				builder.descend();
-				builder.append(AST::createNode(bounds[i.value()].elementName));
-				builder.descend();
-				boundStack.push(i.value());
+				a.append(AST());
+				a[j] = move(bound[j]);
 			}
-			else if (!boundStack.empty() && bounds[boundStack.top()].end.compare(i.value()) == 0)
+		}));
+
+		if (onNode)
+			onNode(builder.head(), builder, (s.nodeErrors != NULL ? *s.nodeErrors : e), *this);
+		if (!s.boundStack.empty() && (filled && boundTable[s.boundStack.back()].endIsParentSplit))
+		{
+			builder.append(AST::createNode(boundTable[s.boundStack.back()].elementName));
+			builder.descend();
+		}
+		return close+1;
+	}
+
+	size_t StructureParser::skipBound(const vector<Token> &toks, size_t i, ErrorHandler &e, bool &filled)
+	{
+		size_t width = kinds.size()+1;
+		vector<uint32_t> open;
+		vector<bool> full;
+		// Start-points open the same bound in every state.
+		open.push_back(transitions[boundOrder.size()*width+kindOf(toks[i])].bound);
+		full.push_back(false);
+
+		for (i++; i < toks.size(); i++)
+		{
+			const Token &t = toks[i];
+			if (t.filtered())
+				continue;
+
+			const Transition &tr = transitions[open.back()*width+kindOf(t)];
+			switch (tr.action)
+			{
+			case OpenAction:
+				full.back() = true;
+				open.push_back(tr.bound);
+				full.push_back(false);
+				break;
+			case CloseAction:
 			{
-				AST *head = &(builder.head());
-				builder.ascend();
-				builder.ascend();
-				boundStack.pop();
-				if (onNode)
-					onNode(builder.head(), builder, e, *this);
-				if (!boundStack.empty() && (head->size() > 0 && bounds[boundStack.top()].endIsParentSplit))
+				bool f = full.back();
+				open.pop_back();
+				full.pop_back();
+				if (open.empty())
 				{
-					builder.append(AST::createNode(bounds[boundStack.top()].elementName));
-					builder.descend();
+					filled = f;
+					return i;
 				}
+				// Parsing this leaves the builder an element deeper than the bound stack, which a lazy node
+				// cannot reproduce, so the bound is not skipped.
+				if (f && boundTable[open.back()].endIsParentSplit)
+					return Unmatched;
+				break;
+			}
+			case SplitAction:
+				full.back() = false;
+				break;
+			case MismatchAction:
+				e.mismatchedStructureBounds(t, boundOrder[tr.bound], t.value());
+				break;
+			default:
+				full.back() = true;
+				break;
+			}
+		}
+
+		return Unmatched;
+	}
+
+	AST StructureParser::parse(const vector<Token> &toks, ErrorHandler &e)
+	{
+		ParseState s;
+		begin(s);
+		for (size_t i = 0; i < toks.size(); )
+			i = stepAt(s, toks, i, e);
+		return end(s, e);
+	}
+
+	AST StructureParser::parse(shared_ptr<const vector<Token> > toks, ErrorHandler &e)
+	{
+		ParseState s;
+		begin(s);
+		s.source = toks;
+		for (size_t i = 0; i < toks->size(); )
+			i = stepAt(s, *toks, i, e);
+		return end(s, e);
+	}
+
+	vector<size_t> StructureParser::matchBounds(const vector<Token> &toks, ErrorHandler &e)
+	{
+		if (!compiled)
+			compile();
+
+		vector<size_t> rtn(toks.size(), Unmatched);
+		vector<pair<size_t, uint32_t> > open;
+		size_t width = kinds.size()+1;
+		uint32_t outside = (uint32_t)boundOrder.size();
+
+		for (size_t i = 0; i < toks.size(); i++)
+		{
+			const Token &t = toks[i];
+			if (t.filtered())
+				continue;
+
+			// Most tokens are not bound points, so they are rejected before the transition table is read.
+			int k = kindOf(t);
+			if (k == 0)
+				continue;
+
+			uint32_t state = (open.empty() ? outside : open.back().second);
+			const Transition &tr = transitions[state*width+k];
+			if (tr.action == OpenAction)
+			{
+				open.push_back(make_pair(i, tr.bound));
 			}
-			else if (!boundStack.empty() && bounds[boundStack.top()].split.compare(i.value()) == 0)
+			else if (tr.action == CloseAction)
 			{
-				builder.ascend();
-				if (onNode)
-					onNode(builder.head(), builder, e, *this);
-				builder.append(AST::createNode(bounds[boundStack.top()].elementName));
-				builder.descend();
+				rtn[i] = open.back().first;
+				rtn[open.back().first] = i;
+				open.pop_back();
 			}
-			else if (boundStack.empty() && globalSplitToken.compare(i.value()) == 0)
+			else if (tr.action == MismatchAction)
 			{
-				builder.ascend();
-				if (onNode)
-					onNode(builder.head(), builder, e, *this);
-				builder.append(AST::createNode(globalSplitName));
-				builder.descend();
+				e.mismatchedStructureBounds(t, boundOrder[tr.bound], t.value());
 			}
-			else if (boundEnds.find(i.value()) != boundEnds.end())
+		}
+
+		if (!open.empty())
+		{
+			uint32_t b = open.back().second;
+			e.incompleteStructureBound(toks[open.back().first], boundOrder[b], boundTable[b].end);
+		}
+
+		return rtn;
+	}
+
+	void StructureParser::feed(const Token &t, ErrorHandler &e)
+	{
+		if (!stream)
+		{
+			stream = make_shared<ParseState>();
+			begin(*stream);
+		}
+		step(*stream, t, e);
+	}
+
+	AST StructureParser::finish(ErrorHandler &e)
+	{
+		if (!stream)
+		{
+			stream = make_shared<ParseState>();
+			begin(*stream);
+		}
+
+		shared_ptr<ParseState> s = stream;
+		stream.reset();
+		return end(*s, e);
+	}
+
+	AST StructureParser::parse(TokenStream &ts, ErrorHandler &e)
+	{
+		if (!ts.retainInput)
+			throw runtime_error("cannot parse a token stream which does not retain its input");
+
+		ParseState s;
+		begin(s);
+		while (!ts.empty())
+			step(s, ts.next(), e);
+		return end(s, e);
+	}
+
+	/* A bounded queue of token batches between the lexing and the parsing thread of parsePipelined. Either
+	 * side may stop early: the lexer by closing the queue, and the parser by cancelling it, which makes
+	 * the lexer's pushes return right away.
+	 */
+	class TokenPipe
+	{
+	protected:
+		mutex lock;
+		condition_variable notFull, notEmpty;
+		deque<vector<Token> > batches;
+		size_t capacity;
+		bool closed, cancelled;
+
+	public:
+		TokenPipe(size_t c) : capacity(c > 0 ? c : 1), closed(false), cancelled(false) {}
+
+		bool push(vector<Token> &b)
+		{
+			unique_lock<mutex> l(lock);
+			notFull.wait(l, [this]() { return batches.size() < capacity || cancelled; });
+			if (cancelled)
+				return false;
+			batches.push_back(vector<Token>());
+			batches.back().swap(b);
+			notEmpty.notify_one();
+			return true;
+		}
+
+		bool pop(vector<Token> &b)
+		{
+			unique_lock<mutex> l(lock);
+			notEmpty.wait(l, [this]() { return !batches.empty() || closed; });
+			if (batches.empty())
+				return false;
+			b.swap(batches.front());
+			batches.pop_front();
+			notFull.notify_one();
+			return true;
+		}
+
+		void close()
+		{
+			lock_guard<mutex> l(lock);
+			closed = true;
+			notEmpty.notify_one();
+		}
+
+		void cancel()
+		{
+			lock_guard<mutex> l(lock);
+			cancelled = true;
+			notFull.notify_one();
+		}
+	};
+
+	AST StructureParser::parsePipelined(LexerState l, shared_ptr<const SourceBuffer> b, ErrorHandler &e, size_t batches)
+	{
+		static const size_t BatchSize = 4096;
+
+		TokenPipe pipe(batches);
+		exception_ptr lexFailure;
+		InternalErrorHandler lexErrors;
+		SourceTable::Scope *scope = SourceTable::Scope::current();
+		thread lexer([&]()
+		{
+			SourceTable::Scope::Join join(scope);
+			try
 			{
-				bool found = false;
-				for (auto j : bounds)
+				vector<Token> batch;
+				batch.reserve(BatchSize);
+				bool open = true;
+				auto sink = [&](const Token &t)
 				{
-					if (j.second.end.compare(i.value()) == 0)
+					if (!open)
+						return;
+					batch.push_back(t);
+					if (batch.size() == BatchSize)
 					{
-						e.mismatchedStructureBounds(i, j.first, i.value());
-						found = true;
-						break;
+						open = pipe.push(batch);
+						batch.clear();
+						batch.reserve(BatchSize);
 					}
-				}
+				};
+				l.lexTo(b, lexErrors, sink);
+				if (open && !batch.empty())
+					pipe.push(batch);
+			}
+			catch (...)
+			{
+				lexFailure = current_exception();
+			}
+			pipe.close();
+		});
 
-				if (!found)
-					throw runtime_error("bound set improperly configured");
+		ParseState s;
+		vector<Token> batch;
+		try
+		{
+			begin(s);
+			while (pipe.pop(batch))
+			{
+				for (auto &i : batch)
+					step(s, i, e);
 			}
-			else
+		}
+		catch (...)
+		{
+			pipe.cancel();
+			lexer.join();
+			throw;
+		}
+
+		lexer.join();
+		if (lexFailure)
+			rethrow_exception(lexFailure);
+		return end(s, e);
+	}
+
+	AST StructureParser::parseParallel(const vector<Token> &toks, ErrorHandler &e, size_t threads)
+	{
+		// Elements are handed out to the workers in runs of this many, so that they rarely contend.
+		static const size_t RunSize = 64;
+
+		if (!compiled)
+			compile();
+
+		if (threads == 0)
+			threads = thread::hardware_concurrency();
+		if (globalSplitToken.empty() || threads < 2)
+			return parse(toks, e);
+
+		// The splits of the global bound. Bounds are skipped whole; after one which is unmatched, or which
+		// skipBound refuses because the builder would be left deeper than the bound stack, every token is
+		// in the last element, which is parsed as usual.
+		InternalErrorHandler skipErrors;
+		vector<size_t> splits;
+		size_t width = kinds.size()+1;
+		uint32_t outside = (uint32_t)boundOrder.size();
+		for (size_t i = 0; i < toks.size(); i++)
+		{
+			if (toks[i].filtered())
+				continue;
+
+			const Transition &t = transitions[outside*width+kindOf(toks[i])];
+			if (t.action == OpenAction)
+			{
+				bool filled = false;
+				size_t close = skipBound(toks, i, skipErrors, filled);
+				if (close == Unmatched)
+					break;
+				i = close;
+			}
+			else if (t.action == GlobalSplitAction)
 			{
-				builder.append(i);
-				if (onNode)
-					onNode(builder.head().rightmost(), builder, e, *this);
+				splits.push_back(i);
 			}
 		}
 
-		if (!toks.empty() && boundStack.size() > 1)
+		if (splits.empty())
+			return parse(toks, e);
+		splits.push_back(toks.size());
+
+		size_t count = splits.size();
+		vector<AST> elements(count);
+		vector<DeferredErrorHandler> errors(count);
+		vector<uint32_t> lastStack;
+		shared_ptr<const vector<Token> > source;
+		shared_ptr<StructureParser> parser;
+		if (hasLazyBounds)
 		{
-			e.incompleteStructureBound(toks[0], boundStack.top(), bounds[boundStack.top()].end);
+			source = make_shared<const vector<Token> >(toks);
+			parser = make_shared<StructureParser>(*this);
 		}
+		atomic<size_t> next(0);
+		atomic<bool> failed(false);
+		exception_ptr failure;
+		mutex failureLock;
+		SourceTable::Scope *scope = SourceTable::Scope::current();
 
-		if (onNode)
-			onNode(builder.root(), builder, e, *this);
-		return builder.root();
+		auto work = [&]()
+		{
+			SourceTable::Scope::Join join(scope);
+			try
+			{
+				for (size_t r = next.fetch_add(RunSize); r < count && !failed; r = next.fetch_add(RunSize))
+				{
+					for (size_t k = r; k < r+RunSize && k < count; k++)
+					{
+						ParseState s;
+						s.source = source;
+						s.parser = parser;
+						s.expansionErrors = &e;
+						s.builder.append(AST::createNode(globalSplitName));
+						s.builder.descend();
+						for (size_t i = (k == 0 ? 0 : splits[k-1]+1); i < splits[k]; )
+							i = stepAt(s, toks, i, errors[k]);
+
+						if (k+1 < count)
+						{
+							s.builder.ascend();
+							if (onNode)
+								onNode(s.builder.head(), s.builder, errors[k], *this);
+						}
+						else
+						{
+							lastStack.swap(s.boundStack);
+						}
+
+						elements[k] = move(s.builder.root()[0]);
+					}
+				}
+			}
+			catch (...)
+			{
+				lock_guard<mutex> l(failureLock);
+				if (!failure)
+					failure = current_exception();
+				failed = true;
+			}
+		};
+
+		vector<thread> workers;
+		for (size_t i = 1; i < threads && i*RunSize < count; i++)
+			workers.push_back(thread(work));
+		work();
+		for (auto &i : workers)
+			i.join();
+		if (failure)
+			rethrow_exception(failure);
+
+		ParseState s;
+		s.first = toks.front();
+		s.fed = true;
+		s.boundStack.swap(lastStack);
+		AST &root = s.builder.root();
+		for (size_t k = 0; k < count; k++)
+		{
+			root.append(AST());
+			root[k] = move(elements[k]);
+			errors[k].replay(e);
+		}
+		return end(s, e);
 	}
 }
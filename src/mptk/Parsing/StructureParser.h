@@ -42,13 +42,18 @@
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
+#include <algorithm>
 #include <stdexcept>
 #include <functional>
+#include <memory>
 
 #include "../Core/Token.h"
 #include "../Core/AST.h"
 #include "../Core/ASTBuilder.h"
 #include "../Core/ErrorHandler.h"
+#include "../Lexing/KeywordTable.h"
+#include "../Lexing/LexerState.h"
+#include "../Lexing/TokenStream.h"
 
 namespace mitten
 {
@@ -68,33 +73,147 @@ namespace mitten
 			std::string boundName; //! AST node name for the bound.
 			std::string elementName; //! AST node name for an element of the bound.
 			bool endIsParentSplit; //! Set to true to enable end-is-parent-split. See the MPTK Algorithms pamphlet for more details.
+			bool lazy; //! Set to true to defer parsing the bound until it is first read.
 
 			/*! \brief Constructor.
 			 * Initializes an empty bound.
 			 */
-			Bound() : endIsParentSplit(false) {}
+			Bound() : endIsParentSplit(false), lazy(false) {}
 
 			/*! \brief Constructor.
 			 * Initializes a bound with no split.
 			 */
-			Bound(std::string n, std::string e) : boundName(n), end(e) {}
+			Bound(std::string n, std::string e) : end(e), boundName(n), endIsParentSplit(false), lazy(false) {}
 
 			/*! \brief Constructor.
 			 * Initializes a full bound/split pairing.
 			 */
-			Bound(std::string n, std::string e, std::string en, std::string s) : boundName(n), end(e), elementName(en), split(s) {}
+			Bound(std::string n, std::string e, std::string en, std::string s) : end(e), split(s), boundName(n), elementName(en), endIsParentSplit(false), lazy(false) {}
 
 			/*! \brief Configures the end-is-parent-split option.
 			 * Can be used easily, as references to bound declarations are returned by the bind method of the parent class.
 			 */
 			Bound &setEndIsParentSplit(bool v);
+
+			/*! \brief Configures the lazy option.
+			 * When parsing a token vector, a lazy bound is skipped by matching its end-point and becomes a lazy
+			 * AST node holding the tokens between its start- and end-points, which are only parsed when the node
+			 * is first read. See AST::createLazyNode.
+			 */
+			Bound &setLazy(bool v);
 		} Bound;
 
 		std::string globalBoundName; //! AST node name for the global bound (often 'global').
 		std::string globalSplitName; //! AST node name for the global bound element (i.e. a line of code).
 		std::string globalSplitToken; //! The token which is used for the global split element (i.e. a line of code in the global context).
 		std::unordered_map<std::string, Bound> bounds; //! List of bounds sorted by start-point.
-		std::unordered_set<std::string> boundEnds; //! Set of all bound end-points - used for error checking.
+		std::vector<std::string> boundOrder; //! The start-points of the bounds, in the order they were first bound.
+
+		/*! \brief What the parser does upon a token, given the innermost bound.
+		 */
+		typedef enum
+		{
+			LeafAction, //! Appends the token as a leaf.
+			OpenAction, //! Opens a bound.
+			CloseAction, //! Closes the innermost bound.
+			SplitAction, //! Starts a new element of the innermost bound.
+			GlobalSplitAction, //! Starts a new element of the global bound.
+			MismatchAction //! Reports the end-point of a bound other than the innermost one.
+		} TransitionAction;
+
+		/*! \brief Helper type.
+		 * An entry of the transition table.
+		 */
+		typedef struct Transition
+		{
+			uint32_t action; //! The TransitionAction.
+			uint32_t bound; //! The index of the bound opened, or whose end-point was mismatched.
+		} Transition;
+
+		/*! \brief The bound start-, end- and split-points, numbered as token kinds from 1.
+		 * Every other token is of kind 0.
+		 */
+		KeywordTable kinds;
+
+		/*! \brief The transition table.
+		 * Indexed by state*(kinds.size()+1)+kind, where the state is the index in boundOrder of the innermost
+		 * bound, or boundOrder.size() outside of all bounds.
+		 */
+		std::vector<Transition> transitions;
+
+		std::vector<Bound> boundTable; //! The bounds as compiled, by index in boundOrder.
+		KeywordTable tokenKeywords; //! The keyword table of the lexer, if set with setKeywords.
+		std::vector<int> keywordKinds; //! The kind of each keyword id of the lexer.
+		bool kindsNeedLookup; //! Set if some kinds are not keywords of the lexer, so that tokens without a keyword id must be looked up.
+		bool compiled; //! Whether kinds and transitions are up to date with the bounds.
+		bool hasLazyBounds; //! Whether any bound is lazy, as compiled.
+
+		/*! \brief Helper type.
+		 * The state of a parse in progress.
+		 */
+		typedef struct ParseState
+		{
+			ASTBuilder builder; //! The tree being built.
+			std::vector<uint32_t> boundStack; //! The indices of the bounds open, innermost last.
+			Token first; //! The first token parsed, for error reporting.
+			bool fed; //! Whether any token has been parsed.
+			std::shared_ptr<const std::vector<Token> > source; //! The tokens parsed, NULL until a lazy bound is deferred unless given.
+			std::shared_ptr<StructureParser> parser; //! A copy of the parser for parsing lazy bounds later, NULL until one is deferred.
+			ErrorHandler *nodeErrors; //! The error handler onNode is given, NULL for the one the tokens are parsed with.
+			ErrorHandler *expansionErrors; //! The error handler onNode is given when lazy nodes are expanded, NULL for the one the tokens are parsed with.
+
+			/*! \brief Constructor.
+			 * Initializes the state of a parse with no tokens yet.
+			 */
+			ParseState() : fed(false), nodeErrors(NULL), expansionErrors(NULL) {}
+		} ParseState;
+
+		std::shared_ptr<ParseState> stream; //! The parse fed by feed(), NULL if none is in progress.
+
+		/*! \brief Numbers the bound points as kinds and builds the transition table.
+		 */
+		void compile();
+
+		/*! \brief Starts a parse.
+		 */
+		void begin(ParseState &s);
+
+		/*! \brief Parses one token.
+		 */
+		void step(ParseState &s, const Token &t, ErrorHandler &e);
+
+		/*! \brief Ends a parse.
+		 * \returns The resultant AST.
+		 */
+		AST end(ParseState &s, ErrorHandler &e);
+
+		/*! \brief Parses one token of a token vector.
+		 * The same as step, except that a lazy bound is skipped whole if the parse has a source.
+		 * \returns The index of the next token to parse.
+		 */
+		size_t stepAt(ParseState &s, const std::vector<Token> &toks, size_t i, ErrorHandler &e);
+
+		/*! \brief Finds the end-point of the bound started by a token, without building a tree.
+		 * Mismatched end-points within the bound are reported as parse would.
+		 * \param toks Input token vector.
+		 * \param i The index of the start-point.
+		 * \param e Error handler to use.
+		 * \param filled Set to whether the last element of the bound is non-empty.
+		 * \returns The index of the end-point; Unmatched if there is none, or if a bound within it ends an
+		 * element by end-is-parent-split, so that it must be parsed as usual.
+		 */
+		size_t skipBound(const std::vector<Token> &toks, size_t i, ErrorHandler &e, bool &filled);
+
+		/*! \brief Gets the kind of a token.
+		 */
+		int kindOf(const Token &t) const
+		{
+			KeywordId k = t.keyword();
+			if (k != NoKeyword && k < keywordKinds.size())
+				return keywordKinds[k];
+			// Tokens which own their values have no keyword ids.
+			return (kindsNeedLookup || t.owned() ? kinds.find(t.view()) : 0);
+		}
 		
 		std::unordered_map<std::string, AST> semanticMacros; //! The dictionary of all semantic macros.
 
@@ -104,6 +223,8 @@ namespace mitten
 		 * AST builder object. The last argument is a reference to the current error handler object.
 		 */
 		std::function<void (AST &, ASTBuilder &, ErrorHandler &, StructureParser &)> onNode;
+
+		static const size_t Unmatched = (size_t)-1; //! The match of a token which is not a matched bound point.
 	
 		/*! \brief Constructor.
 		 * Creates a new structure parser with no bounds.
@@ -123,6 +244,19 @@ namespace mitten
 		 */
 		Bound &bind(std::string n, std::string st, std::string e, std::string en = "", std::string sp = "");
 
+		/*! \brief Declares a new bound by keyword ids.
+		 * The same as bind with the names of the keywords, for bounds whose points are registered as
+		 * keywords with the lexer.
+		 * \param k The keyword table the ids are from, usually Lexer::keywordTable().
+		 * \param n Node name.
+		 * \param st Start point.
+		 * \param e End point.
+		 * \param en Element node name.
+		 * \param sp Split point, NoKeyword if none.
+		 * \returns A reference to the newly created bound declaration.
+		 */
+		Bound &bind(const KeywordTable &k, std::string n, KeywordId st, KeywordId e, std::string en = "", KeywordId sp = NoKeyword);
+
 		/*! \brief Sets a global split token.
 		 * The global split token exists for element separators in the global scope.
 		 * \param en The element name.
@@ -135,6 +269,13 @@ namespace mitten
 		 * \param n The node name.
 		 */
 		void setGlobalBoundName(std::string n);
+
+		/*! \brief Sets the keyword table of the lexer the tokens parsed come from.
+		 * Bound points registered as keywords with the lexer are then told apart by the keyword ids of the
+		 * tokens alone; if all of them are, no token is hashed or compared while parsing.
+		 * \param k The keyword table, usually Lexer::keywordTable().
+		 */
+		void setKeywords(const KeywordTable &k);
 		
 		/*! \brief Defines a new macro.
 		 * \param s The name of the macro.
@@ -158,12 +299,92 @@ namespace mitten
 		AST getMacroValue(std::string s);
 
 		/*! \brief Runs parser.
-		 * Requires the use of an input token vector and an error handler with which to store errors.
+		 * Requires the use of an input token vector and an error handler with which to store errors. Lazy
+		 * bounds become lazy AST nodes, which keep a copy of the parser and, once the first of them is
+		 * deferred, of the token vector; prefer the overload taking a shared_ptr for lazy parsing, which shares
+		 * the vector instead. The structural errors in lazy bounds are reported now, but onNode is only run for
+		 * their nodes when they are expanded, with \p e, which must then outlive the expansion of the AST.
+		 * \param toks Input token vector.
+		 * \param e Error handler to use.
+		 * \returns Resultant AST.
+		 */
+		AST parse(const std::vector<Token> &toks, ErrorHandler &e);
+
+		/*! \brief Runs parser.
+		 * The same as parse() given a token vector, except that lazy AST nodes share \p toks rather than
+		 * copying it. This is the one to use with lazy bounds.
+		 * \param toks Input token vector.
+		 * \param e Error handler to use.
+		 * \returns Resultant AST.
+		 */
+		AST parse(std::shared_ptr<const std::vector<Token> > toks, ErrorHandler &e);
+
+		/*! \brief Matches the bound start- and end-points of a token vector, without building a tree.
+		 * Runs in one linear pass over the tokens, with the same bounds and errors as parse: mismatched
+		 * end-points are reported with ErrorHandler::mismatchedStructureBounds, and a bound left open with
+		 * ErrorHandler::incompleteStructureBound. The result can be used to skip whole bounds, for example to
+		 * find the splits of the global bound or to defer parsing bodies.
+		 * \param toks Input token vector.
+		 * \param e Error handler to use.
+		 * \returns For each token, the index of the end-point of the bound it starts or of the start-point of
+		 * the bound it ends; Unmatched for every other token, including points which were not matched.
+		 */
+		std::vector<size_t> matchBounds(const std::vector<Token> &toks, ErrorHandler &e);
+
+		/*! \brief Parses one token of input given token by token.
+		 * The tree is built as tokens arrive, and onNode is run for each node as soon as it is complete.
+		 * Call finish() after the last token.
+		 * \param t The next token.
+		 * \param e Error handler to use.
+		 */
+		void feed(const Token &t, ErrorHandler &e);
+
+		/*! \brief Ends a parse of input given by feed().
+		 * \param e Error handler to use.
+		 * \returns Resultant AST.
+		 */
+		AST finish(ErrorHandler &e);
+
+		/*! \brief Runs parser on tokens pulled from a stream.
+		 * Tokens are parsed as they are lexed, so the whole token vector never exists at once. The values of
+		 * the tokens are kept in the AST, so the stream must retain its input; a runtime_error is thrown if
+		 * it does not.
+		 * \param s Input token stream.
+		 * \param e Error handler to use.
+		 * \returns Resultant AST.
+		 */
+		AST parse(TokenStream &s, ErrorHandler &e);
+
+		/*! \brief Lexes and parses a source buffer on two threads.
+		 * A second thread lexes the buffer and passes batches of tokens to the calling thread, which parses
+		 * them and runs onNode, through a bounded queue. The result is the same as parsing the result of
+		 * lexing the buffer.
+		 * \param l The lexer state, which is used on the lexing thread only.
+		 * \param b The input source buffer.
+		 * \param e Error handler to use; it is only used by the calling thread.
+		 * \param batches The number of batches of tokens the queue holds.
+		 * \returns Resultant AST.
+		 */
+		AST parsePipelined(LexerState l, std::shared_ptr<const SourceBuffer> b, ErrorHandler &e, size_t batches = 16);
+
+		/*! \brief Runs parser on several threads, one element of the global bound at a time.
+		 * The splits of the global bound are found first, skipping over bounds by matching their end-points,
+		 * and the subtree of each element is then built on a worker thread. The subtrees are joined under the
+		 * global node in source order, so the result and the errors reported are the same as those of parse.
+		 * If there is no global split token, or only one element, the tokens are parsed on the calling thread.
+		 *
+		 * onNode is run on the worker threads, so it must be safe to run concurrently for different elements
+		 * of the global bound; for the nodes of one element it is run in the same order as by parse. On a
+		 * worker thread, the builder given to onNode is that worker's own, whose root holds only the element
+		 * being built, and the error handler given records errors to be reported to \p e, in source order,
+		 * once all the elements are built. onNode is run for the global node on the calling thread, and for the
+		 * nodes of lazy bounds when they are expanded, with \p e itself.
 		 * \param toks Input token vector.
 		 * \param e Error handler to use.
+		 * \param threads The number of worker threads; 0 for the number of hardware threads.
 		 * \returns Resultant AST.
 		 */
-		AST parse(std::vector<Token> toks, ErrorHandler &e);
+		AST parseParallel(const std::vector<Token> &toks, ErrorHandler &e, size_t threads = 0);
 	};
 }
 
@@ -65,5 +65,20 @@ int main()
 	test.assert(branch.rightmost().isLeaf());
 	test.assert(branch.rightmost().leaf().value().compare("hi") == 0);
 
+	auto toks = make_shared<const vector<Token> >(vector<Token>({Token("a"), Token("b"), Token("c")}));
+	int expansions = 0;
+	AST lazy = AST::createLazyNode("lazy", toks, 1, 3, [&](AST &a, const vector<Token> &t, size_t f, size_t l)
+	{
+		for (size_t i = f; i < l; i++)
+			a.append(t[i]);
+		expansions++;
+	});
+
+	test.assert(lazy.isBranch() && lazy.isLazy() && lazy.deferredTokens().size() == 2 && expansions == 0);
+	AST copy = lazy;
+	test.assert(lazy.size() == 2 && !lazy.isLazy() && expansions == 1);
+	test.assert(copy.isLazy() && copy.size() == 2 && copy.display() == lazy.display() && expansions == 1);
+	test.assert(lazy[1].leaf().value().compare("c") == 0 && lazy.display() == "(lazy: 'b' 'c')" && expansions == 1);
+
 	return (int)(test.write());
 }
\ No newline at end of file
@@ -35,11 +35,21 @@
  */
 
 #include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
 #include <MUnit.h>
 
 #include "../Core/Token.h"
 #include "../Core/Reconstruction.h"
 #include "../Lexing/Lexer.h"
+#include "../Lexing/TokenStream.h"
+#include "../Lexing/MacroTable.h"
+#include "../Lexing/StaticLexer.h"
+#include "../Lexing/TokenSink.h"
+#include "../Lexing/TokenCache.h"
+#include "../Lexing/ModalLexer.h"
 
 using namespace std;
 using namespace mitten;
@@ -51,6 +61,35 @@ void myOnToken(Token t, vector<Token> &v, ErrorHandler &e)
 	ntoks++;
 }
 
+struct ComplainingLexer
+{
+	Lexer &lexer;
+
+	ComplainingLexer(Lexer &l) : lexer(l) {}
+
+	uint64_t fingerprint() { return ~lexer.fingerprint(); }
+
+	vector<Token> lex(shared_ptr<const SourceBuffer> b, ErrorHandler &eh, int lineoff, int columnoff)
+	{
+		eh.expectedExpression(Token("x"));
+		return lexer.lex(b, eh, lineoff, columnoff);
+	}
+};
+
+bool sameTokens(vector<Token> a, TokenStream &b)
+{
+	for (auto &i : a)
+	{
+		if (b.empty())
+			return false;
+		Token t = b.next();
+		if (t.value().compare(i.value()) != 0 || t.line() != i.line() || t.column() != i.column() || t.tag() != i.tag() || t.filtered() != i.filtered())
+			return false;
+	}
+
+	return b.empty();
+}
+
 int main()
 {
 	Test test = Test("LexerTest");
@@ -116,9 +155,446 @@ int main()
 
 	test.assert(toks.size() == 5);
 
+	MacroTable macros;
+	test.assert(!macros.find("A"));
+	for (int i = 0; i < 200; i++)
+		macros.define("M"+to_string(i), vector<Token>(i%3, Token(to_string(i))));
+	for (int i = 0; i < 200; i += 2)
+		macros.undefine("M"+to_string(i));
+
+	bool found = (macros.size() == 100);
+	for (int i = 0; i < 200; i++)
+	{
+		MacroTable::Body b = macros.find("M"+to_string(i));
+		if ((bool)b != (i%2 == 1) || (b && b->size() != (size_t)(i%3)))
+			found = false;
+	}
+	test.assert(found);
+	test.assert(!macros.find("M"));
+	test.assert(!macros.find("N1"));
+
 	lexer.onToken = myOnToken;
 	toks = lexer.lex(page, "--", eh);
 	test.assert(ntoks == 5);
 
+	Lexer opLexer;
+	opLexer.deliminate("<");
+	opLexer.deliminate("<<");
+	opLexer.deliminate("<<=");
+	opLexer.deliminate("=");
+
+	toks = opLexer.lex("a<<=b<c", "--", eh);
+	test.assert(toks.size() == 5);
+	test.assert(toks[1].value().compare("<<=") == 0);
+	test.assert(toks[2].value().compare("b") == 0);
+	test.assert(toks[2].column() == 4);
+
+	opLexer.undeliminate("<<=");
+	toks = opLexer.lex("a<<=b", "--", eh);
+	test.assert(toks.size() == 4);
+	test.assert(toks[1].value().compare("<<") == 0);
+	test.assert(toks[2].value().compare("=") == 0);
+
+	Lexer streamLexer;
+	streamLexer.deliminate("<");
+	streamLexer.deliminate("<<=");
+	streamLexer.deliminate(" ") = Filtered;
+	streamLexer.deliminate("\n") = Filtered;
+	streamLexer.deliminate("/*", "*/") = Filtered;
+	streamLexer.deliminate("\"", "\"");
+
+	page = "abc <<= 12 /* long\ncomment */ x<y\n\"str ing\" <<\nlast";
+	toks = streamLexer.lex(page, "--", eh);
+
+	bool streamed = true;
+	for (size_t n = 1; n <= page.size(); n++)
+	{
+		vector<string> chunks;
+		for (size_t i = 0; i < page.size(); i += n)
+			chunks.push_back(page.substr(i, n));
+
+		TokenStream stream(streamLexer, chunks, "--", eh);
+		stream.retainInput = (n%2 == 0);
+		if (!sameTokens(toks, stream))
+			streamed = false;
+	}
+	test.assert(streamed);
+
+	stringstream in(page);
+	TokenStream inStream(streamLexer, in, "--", eh, 3);
+	test.assert(inStream.peek().value().compare("abc") == 0);
+	test.assert(sameTokens(toks, inStream));
+
+	TokenStream emptyStream(streamLexer, vector<string>(), "--", eh);
+	test.assert(emptyStream.empty());
+
+	vector<string> longChunks(1, "a \"");
+	for (int i = 0; i < 20000; i++)
+		longChunks.push_back("0123456789abcde\n");
+	longChunks.push_back("\" b");
+	TokenStream longStream(streamLexer, longChunks, "--", eh);
+	longStream.retainInput = false;
+	test.assert(longStream.next().value().compare("a") == 0 && longStream.next().filtered() && longStream.next().length() == 320002);
+
+	TokenStream boundedStream(streamLexer, vector<string>({"abc def", " ghi\n", "jkl mno\n"}), "--", eh);
+	boundedStream.retainInput = false;
+	Token stale = boundedStream.next();
+	bool detected = false;
+	while (!boundedStream.empty())
+		boundedStream.next();
+	try
+	{
+		stale.value();
+	}
+	catch (runtime_error &e)
+	{
+		detected = true;
+	}
+	test.assert(detected);
+
+	string big;
+	for (int i = 0; i < 200; i++)
+	{
+		big += "x" + to_string(i) + " <<= " + to_string(i*7) + "\n";
+		if (i%13 == 0)
+			big += "/* block\ncomment " + to_string(i) + "\n*/ ";
+		if (i%17 == 0)
+			big += "\"multi\nline string\" ";
+	}
+	big += "tail";
+
+	toks = streamLexer.lex(big, "--", eh);
+	streamLexer.minParallelChunk = 16;
+	bool parallel = true;
+	for (unsigned t = 2; t <= 9; t++)
+	{
+		vector<Token> ptoks = streamLexer.lexParallel(SourceBuffer::fromString(big), eh, t);
+		if (ptoks.size() != toks.size())
+		{
+			parallel = false;
+			continue;
+		}
+
+		for (size_t i = 0; i < toks.size(); i++)
+		{
+			if (ptoks[i].offset() != toks[i].offset() || ptoks[i].length() != toks[i].length() || ptoks[i].tag() != toks[i].tag() || ptoks[i].line() != toks[i].line())
+				parallel = false;
+		}
+	}
+	test.assert(parallel);
+
+	StaticLexer<
+		StaticDeliminator<Chars<'<'> >,
+		StaticDeliminator<Chars<'<', '<', '='> >,
+		StaticDeliminator<Chars<' '>, Chars<>, Filtered>,
+		StaticDeliminator<Chars<'\n'>, Chars<>, Filtered>,
+		StaticDeliminator<Chars<'/', '*'>, Chars<'*', '/'>, Filtered>,
+		StaticDeliminator<Chars<'"'>, Chars<'"'> > > staticLexer;
+
+	toks = streamLexer.lex(big, "--", eh);
+	vector<Token> stoks = staticLexer.lex(big, "--", eh);
+	bool same = (stoks.size() == toks.size());
+	for (size_t i = 0; same && i < toks.size(); i++)
+	{
+		if (stoks[i].value() != toks[i].value() || stoks[i].tag() != toks[i].tag() || stoks[i].filtered() != toks[i].filtered() || stoks[i].line() != toks[i].line() || stoks[i].column() != toks[i].column())
+			same = false;
+	}
+	test.assert(same);
+
+	Lexer mirrored;
+	decltype(staticLexer)::deliminate(mirrored);
+	test.assert(mirrored.lex(big, "--", eh).size() == toks.size());
+
+	vector<Token> sunk;
+	auto collect = [&sunk](const Token &t)
+	{
+		if (!t.filtered())
+			sunk.push_back(t);
+	};
+	streamLexer.lexTo(SourceBuffer::fromString(big), eh, collect);
+
+	size_t unfiltered = 0;
+	for (auto &i : toks)
+	{
+		if (!i.filtered())
+			unfiltered++;
+	}
+	test.assert(sunk.size() == unfiltered);
+
+	ntoks = 0;
+	CallbackTokenSink batched(myOnToken);
+	streamLexer.lex(SourceBuffer::fromString(big), eh, batched);
+	test.assert(ntoks == (int)toks.size());
+
+	CallbackTokenSink appended(nullptr);
+	streamLexer.lex(SourceBuffer::fromString(big), eh, appended);
+	test.assert(appended.tokens.size() == toks.size() && appended.tokens.back().offset() == toks.back().offset());
+
+	vector<string> inserts = {"y", " ", "/* ", "<", "\"", "", "abc def\n"};
+	bool relexed = true;
+	bool local = true;
+	string current = big;
+	vector<Token> ctoks = streamLexer.lex(current, "--", eh);
+	for (size_t k = 0; k < 40; k++)
+	{
+		size_t offset = (k*997)%current.size();
+		size_t removed = (k%3 == 0 ? k%5 : 0);
+		if (offset+removed > current.size())
+			removed = current.size()-offset;
+		string edited = current.substr(0, offset)+inserts[k%inserts.size()]+current.substr(offset+removed);
+
+		size_t changedBegin, changedEnd;
+		Lexer::Edit e(offset, removed, inserts[k%inserts.size()].size());
+		vector<Token> rtoks = streamLexer.relex(ctoks, e, SourceBuffer::fromString(edited), eh, changedBegin, changedEnd);
+		vector<Token> etoks = streamLexer.lex(edited, "--", eh);
+		current = edited;
+		ctoks = rtoks;
+
+		if (rtoks.size() != etoks.size())
+		{
+			relexed = false;
+			continue;
+		}
+
+		for (size_t i = 0; i < etoks.size(); i++)
+		{
+			if (rtoks[i].offset() != etoks[i].offset() || rtoks[i].length() != etoks[i].length() || rtoks[i].tag() != etoks[i].tag() || rtoks[i].filtered() != etoks[i].filtered() || rtoks[i].line() != etoks[i].line() || rtoks[i].value() != etoks[i].value())
+				relexed = false;
+		}
+
+		if (k%inserts.size() == 0 && changedEnd-changedBegin > 8)
+			local = false;
+	}
+	test.assert(relexed);
+	test.assert(local);
+
+	size_t changedBegin, changedEnd;
+	Token foreign = streamLexer.lex("xyz q", "--", eh).front();
+	ctoks = streamLexer.lex("a b c d e f g h", "--", eh);
+	ctoks.push_back(foreign);
+	ctoks = streamLexer.relex(ctoks, Lexer::Edit(0, 0, 1), SourceBuffer::fromString("ya b c d e f g h"), eh, changedBegin, changedEnd);
+	test.assert(ctoks.front().value() == "ya" && ctoks[ctoks.size()-2].value() == "h" && ctoks.back().offset() == foreign.offset() && ctoks.back().value() == "xyz");
+
+	vector<Token> before = streamLexer.lex("alpha beta gamma; delta", "--", eh);
+	vector<string> beforeValues;
+	for (auto &i : before)
+		beforeValues.push_back(i.value());
+	vector<Token> after = streamLexer.relex(before, Lexer::Edit(0, 0, 3), SourceBuffer::fromString("XYZalpha beta gamma; delta"), eh, changedBegin, changedEnd);
+	bool kept = true;
+	for (size_t i = 0; i < before.size(); i++)
+		kept = kept && before[i].value() == beforeValues[i];
+	test.assert(kept && after.front().value() == "XYZalpha" && after.back().value() == "delta" && after.back().fileId() != before.back().fileId());
+
+	shared_ptr<const CompiledGrammar> grammar = streamLexer.compile();
+	test.assert(streamLexer.compile() == grammar);
+	vector<vector<Token> > sharedToks(4);
+	vector<thread> lexers;
+	for (size_t k = 0; k < sharedToks.size(); k++)
+	{
+		lexers.push_back(thread([&, k]()
+		{
+			InternalErrorHandler teh;
+			LexerState state(grammar);
+			sharedToks[k] = state.lex(SourceBuffer::fromString(big.substr(k*997)), teh);
+		}));
+	}
+	for (auto &i : lexers)
+		i.join();
+	bool shared = true;
+	for (size_t k = 0; k < sharedToks.size(); k++)
+	{
+		vector<Token> expected = streamLexer.lex(big.substr(k*997), "--", eh);
+		shared = shared && (sharedToks[k].size() == expected.size());
+		for (size_t i = 0; shared && i < expected.size(); i++)
+			shared = (sharedToks[k][i].offset() == expected[i].offset() && sharedToks[k][i].length() == expected[i].length() && sharedToks[k][i].tag() == expected[i].tag());
+	}
+	test.assert(shared);
+
+	vector<TokenSpan> spans;
+	grammar->lexSpans(big, spans);
+	bool spanned = (spans.size() == toks.size());
+	for (size_t i = 0; spanned && i < toks.size(); i++)
+		spanned = (spans[i].offset == toks[i].offset() && spans[i].length == toks[i].length() && spans[i].tag == toks[i].tag() && spans[i].filtered == toks[i].filtered());
+	test.assert(spanned);
+
+	TokenSpan window[7];
+	size_t resumed = 0, from = 0, stop = 0, n;
+	while ((n = grammar->lexSpans(StringRef(big).substr(from), window, 7, true, &stop)) > 0)
+	{
+		for (size_t i = 0; i < n; i++)
+			spanned = spanned && resumed+i < sunk.size() && (window[i].offset+from == sunk[resumed+i].offset() && window[i].tag == sunk[resumed+i].tag());
+		resumed += n;
+		from += stop;
+	}
+	test.assert(spanned && resumed == unfiltered && from == big.size());
+
+	streamLexer.deliminate("@");
+	test.assert(streamLexer.compile() != grammar);
+	test.assert(LexerState(grammar).lex(SourceBuffer::fromString("a@b"), eh).size() == 1 && streamLexer.lex("a@b", "--", eh).size() == 3);
+
+	Lexer copied = lexer;
+	copied.onToken = myOnToken;
+	ntoks = 0;
+	toks = copied.lex("A;\n", "--", eh);
+	test.assert(ntoks == 5 && toks.empty());
+
+	Lexer callbackLexer;
+	size_t comments = 0;
+	callbackLexer.deliminate(" ") = Filtered;
+	callbackLexer.deliminate("#", [&comments](StringRef s, size_t from) -> size_t
+	{
+		comments++;
+		const char *e = (const char *)memchr(s.data(), '\n', s.size());
+		return (e != NULL ? e-s.data() : s.size());
+	});
+	callbackLexer.deliminate("#{", [](StringRef s, size_t from) -> size_t
+	{
+		return (s.size() > 2 && s[2] == '}' ? 3 : Lexer::NoMatch);
+	});
+	toks = callbackLexer.lex("a #{} b #{x c\nd #", "--", eh);
+	test.assert(toks.size() == 10 && toks[2].value() == "#{}" && toks[6].value() == "#{x c" && toks[7].value() == "\nd" && toks[9].value() == "#");
+	test.assert(comments == 2);
+
+	Lexer dollarLexer;
+	dollarLexer.deliminate(" ") = Filtered;
+	dollarLexer.deliminate("\n") = Filtered;
+	dollarLexer.deliminate(";");
+	dollarLexer.deliminate("$");
+	dollarLexer.deliminate("$$", [](StringRef s, size_t from) -> size_t
+	{
+		const char *e = (const char *)memchr(s.data()+2, '$', s.size()-2);
+		return (e != NULL ? e-s.data()+1 : Lexer::NoMatch);
+	});
+	page = "a $$ x + y; $ b;\n$ c $$ d;\ne f $$ open; g";
+	toks = dollarLexer.lex(page, "--", eh);
+	bool deferred = true;
+	for (size_t n = 1; n <= page.size(); n++)
+	{
+		vector<string> chunks;
+		for (size_t i = 0; i < page.size(); i += n)
+			chunks.push_back(page.substr(i, n));
+
+		TokenStream stream(dollarLexer, chunks, "--", eh);
+		if (!sameTokens(toks, stream))
+			deferred = false;
+	}
+	test.assert(deferred);
+
+	vector<Token> unclosed = dollarLexer.lex("$$\na;aba", "--", eh);
+	vector<Token> closed = dollarLexer.relex(unclosed, Lexer::Edit(5, 3, 3), SourceBuffer::fromString("$$\na;;$a"), eh, changedBegin, changedEnd);
+	vector<Token> rescanned = dollarLexer.lex("$$\na;;$a", "--", eh);
+	bool lookedAhead = (closed.size() == rescanned.size() && rescanned.size() == 2);
+	for (size_t i = 0; lookedAhead && i < rescanned.size(); i++)
+		lookedAhead = (closed[i].value() == rescanned[i].value() && closed[i].tag() == rescanned[i].tag());
+	test.assert(lookedAhead);
+
+	ModalLexer modal;
+	modal.mode("text").deliminate("\n") = Filtered;
+	modal.mode("text").deliminate("[", "]");
+	modal.push("text", "#", "command");
+	modal.mode("command").deliminate(" ") = Filtered;
+	modal.push("command", "\"", "string");
+	modal.pop("command", "\n") = Filtered;
+	modal.pop("string", "\"");
+	vector<pair<string, size_t> > moded;
+	auto collectModes = [&moded](const Token &t, size_t m)
+	{
+		if (!t.filtered())
+			moded.push_back(pair<string, size_t>(t.value(), m));
+	};
+	modal.lexTo(SourceBuffer::fromString("see [a] #\n#title \"A [b] #c\" x\ny #z"), eh, collectModes);
+	size_t text = modal.modeIndex("text"), command = modal.modeIndex("command"), quoted = modal.modeIndex("string");
+	vector<pair<string, size_t> > expectedModes = {
+		{"see ", text}, {"[a]", text}, {" ", text}, {"#", text}, {"#", text}, {"title", command}, {"\"", command}, 
+		{"A [b] #c", quoted}, {"\"", quoted}, {"x", command}, {"y ", text}, {"#", text}, {"z", command}
+	};
+	test.assert(moded == expectedModes);
+
+	KeywordTable keywords;
+	for (int i = 0; i < 300; i++)
+		keywords.add("k"+to_string(i*7));
+	bool perfect = (keywords.size() == 300 && keywords.add("k0") == 1);
+	for (int i = 0; i < 2100; i++)
+	{
+		KeywordId k = keywords.find("k"+to_string(i));
+		perfect = perfect && (i%7 == 0 ? k == i/7+1 && keywords.name(k) == "k"+to_string(i) : k == NoKeyword);
+	}
+	test.assert(perfect && keywords.find("") == NoKeyword);
+	KeywordId added = keywords.add("late");
+	test.assert(added == 301 && keywords.find("late") == added && keywords.find("k7") == 2);
+
+	KeywordTable many;
+	for (int i = 0; i < 50000; i++)
+		many.add("word"+to_string(i));
+	KeywordTable copy = many;
+	vector<thread> finders;
+	vector<char> lookedUp(4, 1);
+	for (size_t t = 0; t < lookedUp.size(); t++)
+	{
+		finders.push_back(thread([&, t]()
+		{
+			const KeywordTable &k = (t%2 == 0 ? many : copy);
+			for (int i = 0; i < 50000; i++)
+			{
+				if (k.find("word"+to_string(i)) != i+1 || k.find("other"+to_string(i)) != NoKeyword)
+					lookedUp[t] = 0;
+			}
+		}));
+	}
+	for (auto &i : finders)
+		i.join();
+	test.assert(lookedUp == vector<char>(4, 1));
+
+	lexer.onToken = nullptr;
+	KeywordId includeKeyword = lexer.keyword("include"), openKeyword = lexer.keyword("(");
+	toks = lexer.lex("include(std);\n", "--", eh);
+	test.assert(toks[0].keyword() == includeKeyword && toks[1].keyword() == openKeyword && toks[2].keyword() == NoKeyword && lexer.keywordTable().name(includeKeyword) == "include");
+	staticLexer.keywords = KeywordTable({"print", "<"});
+	stoks = staticLexer.lex("print<x", "--", eh);
+	test.assert(stoks[0].keyword() == 1 && stoks[1].keyword() == 2 && stoks[2].keyword() == NoKeyword);
+
+	char cacheDirectory[] = "/tmp/LexerTestXXXXXX";
+	test.assert(mkdtemp(cacheDirectory) != NULL);
+	TokenCache cache(cacheDirectory);
+	shared_ptr<const SourceBuffer> cachedPage = SourceBuffer::fromString(big+"\nA;\n");
+	vector<Token> fresh = lexer.lex(cachedPage, eh);
+	cache.lex(lexer, cachedPage, eh);
+	vector<Token> loaded = cache.lex(lexer, cachedPage, eh);
+	test.assert(cache.misses == 1 && cache.hits == 1);
+	bool cached = (loaded.size() == fresh.size());
+	for (size_t i = 0; cached && i < fresh.size(); i++)
+	{
+		if (loaded[i].owned() != fresh[i].owned() || loaded[i].offset() != fresh[i].offset() || loaded[i].value() != fresh[i].value() || loaded[i].tag() != fresh[i].tag() || loaded[i].keyword() != fresh[i].keyword() || loaded[i].filtered() != fresh[i].filtered() || loaded[i].line() != fresh[i].line() || loaded[i].column() != fresh[i].column() || loaded[i].file() != fresh[i].file())
+			cached = false;
+	}
+	test.assert(cached);
+
+	lexer.defineMacro("A", avalue);
+	cache.lex(lexer, cachedPage, eh);
+	cache.lex(staticLexer, cachedPage, eh);
+	test.assert(cache.misses == 3 && cache.lex(staticLexer, cachedPage, eh).size() == staticLexer.lex(cachedPage, eh).size() && cache.hits == 2);
+
+	lexer.onToken = myOnToken;
+	ntoks = 0;
+	cache.lex(lexer, cachedPage, eh);
+	test.assert(ntoks > 0 && cache.hits == 2 && cache.misses == 3);
+	lexer.onToken = nullptr;
+
+	cache.lex(dollarLexer, cachedPage, eh);
+	test.assert(dollarLexer.hasCallbacks() && cache.lex(dollarLexer, cachedPage, eh).size() == dollarLexer.lex(cachedPage, eh).size() && cache.hits == 2 && cache.misses == 3);
+
+	StaticLexer<StaticDeliminator<Chars<'<'> >, StaticDeliminator<Chars<'<'>, Chars<>, Filtered> > filteredLast;
+	StaticLexer<StaticDeliminator<Chars<'<'>, Chars<>, Filtered>, StaticDeliminator<Chars<'<'> > > filteredFirst;
+	test.assert(filteredLast.fingerprint() != filteredFirst.fingerprint());
+
+	ComplainingLexer complaining(lexer);
+	InternalErrorHandler ceh;
+	cache.lex(complaining, cachedPage, ceh);
+	ceh.clear();
+	cache.lex(complaining, cachedPage, ceh);
+	test.assert(!ceh.empty() && cache.misses == 5 && cache.hits == 2);
+
+	system(("rm -rf "+string(cacheDirectory)).c_str());
+
 	return (int)(test.write());
 }
\ No newline at end of file
@@ -42,10 +42,40 @@
 #include "../Lexing/Latin/FloatingLiteralTagger.h"
 #include "../Lexing/Latin/IntegerLiteralTagger.h"
 #include "../Lexing/Latin/StringLiteralTagger.h"
+#include "../Lexing/Latin/SymbolTagger.h"
+#include "../Lexing/Latin/TokenClassifier.h"
 
 using namespace std;
 using namespace mitten;
 
+TokenTag chainTag(string s, SymbolTagger &sym, BooleanLiteralTagger &blt, CharacterLiteralTagger &clt, StringLiteralTagger &slt, IntegerLiteralTagger &ilt, FloatingLiteralTagger &flt)
+{
+	bool isInt;
+	try
+	{
+		isInt = ilt.isIntegerLiteral(s);
+	}
+	catch(out_of_range &e)
+	{
+		isInt = true;
+	}
+
+	if (sym.isSymbol(s))
+		return SymbolTag;
+	else if (blt.isBooleanLiteral(s))
+		return BooleanLiteralTag;
+	else if (s.size() >= 1+clt.inQuote.size()+clt.unQuote.size() && clt.isCharacterLiteral(s))
+		return CharacterLiteralTag;
+	else if (slt.isStringLiteral(s))
+		return StringLiteralTag;
+	else if (isInt)
+		return IntegerLiteralTag;
+	else if (flt.isFloatingLiteral(s))
+		return FloatingLiteralTag;
+	else
+		return DeliminatorTag;
+}
+
 int main()
 {
 	Test test = Test("LiteralTaggerTest");
@@ -103,5 +133,39 @@ int main()
 	test.assert(!slt.isStringLiteral("hello, world\\n\""));
 	test.assert(slt.parse("\"hi\\n\"").compare("hi\n") == 0);
 
+	SymbolTagger sym;
+	TokenClassifier classifier;
+	test.assert(classifier.update(sym, blt, clt, slt, flt));
+	test.assert(!classifier.update(sym, blt, clt, slt, flt));
+
+	vector<string> values = {"a", "_a1", "1a", "true", "false", "'a'", "'\\n'", "'ab", "\"s\"", "\"", "\"\"",
+		"0", "12", "-3", "+4", " 5", "1.5", "99999999999", "0x", "0x1F", "0xg", "FFh", "a-h", "h", "-", ".", "..",
+		".5", "-.5", "5-", "e", "1e", "-e5", ".e5", "1e5", "1ee5", "?", "+", "@x", "$", "\t-1", "'", "''"};
+
+	bool same = true;
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (auto &i : values)
+		{
+			if (classifier.classify(i) != chainTag(i, sym, blt, clt, slt, ilt, flt))
+				same = false;
+		}
+
+		if (pass == 0)
+		{
+			sym.allowedFirstChars += "$@";
+			blt.trueToken = "yes";
+			clt.inQuote = "`";
+			clt.unQuote = "`";
+			slt.inQuote = "'";
+			slt.unQuote = "'";
+			flt.allowScientific = false;
+			test.assert(classifier.update(sym, blt, clt, slt, flt));
+		}
+	}
+	test.assert(same);
+	test.assert(classifier.classify("@x") == SymbolTag);
+	test.assert(classifier.classify(".e5") == DeliminatorTag);
+
 	return (int)(test.write());
 }
@@ -40,6 +40,7 @@
 #include "../Core/Token.h"
 #include "../Core/AST.h"
 #include "../Lexing/Lexer.h"
+#include "../Lexing/TokenStream.h"
 #include "../Parsing/StructureParser.h"
 
 using namespace std;
@@ -56,6 +57,14 @@ void myOnNode(AST &a, ASTBuilder &b, ErrorHandler &eh, StructureParser &p)
 	}
 }
 
+class CountingErrorHandler : public InternalErrorHandler
+{
+public:
+	size_t counted;
+
+	CountingErrorHandler() : counted(0) {}
+};
+
 int main()
 {
 	Test test = Test("StructureParserTest");
@@ -89,6 +98,102 @@ int main()
 
 	test.assert(eh.empty());
 
+	KeywordId open = lexer.keyword("("), close = lexer.keyword(")"), comma = lexer.keyword(",");
+	StructureParser keyed;
+	keyed.bind(lexer.keywordTable(), "expression", open, close, "argument", comma);
+	keyed.bind("scope", "{", "}", "line", ";");
+	test.assert(keyed.parse(lexer.lex(page, "--", eh), eh).display() == ast.display());
+	lexer.keyword("{");
+	lexer.keyword("}");
+	lexer.keyword(";");
+	keyed.setKeywords(lexer.keywordTable());
+	test.assert(keyed.parse(lexer.lex(page, "--", eh), eh).display() == ast.display() && eh.empty());
+	keyed.parse(lexer.lex("f(a};", "--", eh), eh);
+	test.assert(!eh.empty());
+	eh = InternalErrorHandler();
+
+	for (auto &i : toks)
+		parser.feed(i, eh);
+	test.assert(parser.finish(eh).display() == ast.display());
+
+	TokenStream stream(lexer, vector<string>({page.substr(0, 20), page.substr(20)}), "--", eh);
+	test.assert(parser.parse(stream, eh).display() == ast.display());
+	TokenStream unretained(lexer, vector<string>({page}), "--", eh);
+	unretained.retainInput = false;
+	bool refused = false;
+	try
+	{
+		parser.parse(unretained, eh);
+	}
+	catch (runtime_error &e)
+	{
+		refused = true;
+	}
+	test.assert(refused);
+
+	string big;
+	for (int i = 0; i < 3000; i++)
+		big += "f"+to_string(i)+"(a, b);\n{ g(c); { h; } }\n";
+	AST sequential = parser.parse(lexer.lex(big, "--", eh), eh);
+	test.assert(parser.parsePipelined(lexer.state(), SourceBuffer::fromString(big), eh, 2).display() == sequential.display() && eh.empty());
+
+	StructureParser global;
+	global.bind("expression", "(", ")", "argument", ",");
+	global.bind("scope", "{", "}", "line", ";");
+	global.setGlobalSplit("line", ";");
+	vector<Token> btoks = lexer.lex(big, "--", eh);
+	sequential = global.parse(btoks, eh);
+	test.assert(global.parseParallel(btoks, eh, 4).display() == sequential.display() && eh.empty());
+	btoks = lexer.lex(big+"f(a}; { g;", "--", eh);
+	sequential = global.parse(btoks, eh);
+	test.assert(!eh.empty());
+	eh = InternalErrorHandler();
+	test.assert(global.parseParallel(btoks, eh, 4).display() == sequential.display() && !eh.empty());
+	eh = InternalErrorHandler();
+
+	StructureParser lazy;
+	lazy.bind("expression", "(", ")", "argument", ",");
+	lazy.bind("scope", "{", "}", "line", ";").setLazy(true);
+	AST deferred = lazy.parse(toks, eh);
+	test.assert(deferred[6].isLazy() && !deferred[6].deferredTokens().empty() && eh.empty());
+	test.assert(deferred.display() == ast.display() && !deferred[6].isLazy());
+	auto shared = make_shared<const vector<Token> >(toks);
+	deferred = lazy.parse(shared, eh);
+	AST copied = deferred;
+	test.assert(deferred[6].isLazy() && deferred.display() == ast.display() && copied.display() == ast.display() && eh.empty());
+	lazy.setGlobalSplit("line", ";");
+	btoks = lexer.lex(big, "--", eh);
+	test.assert(lazy.parse(btoks, eh).display() == global.parse(btoks, eh).display() && eh.empty());
+	test.assert(lazy.parseParallel(btoks, eh, 4).display() == global.parse(btoks, eh).display() && eh.empty());
+	lazy.parse(lexer.lex("{ f(a}; }", "--", eh), eh);
+	test.assert(!eh.empty());
+	eh = InternalErrorHandler();
+
+	lazy.onNode = [](AST &a, ASTBuilder &, ErrorHandler &e, StructureParser &)
+	{
+		if (a.isLeaf() && a.leaf().value() == "c")
+			dynamic_cast<CountingErrorHandler &>(e).counted++;
+	};
+	CountingErrorHandler ceh;
+	deferred = lazy.parse(make_shared<const vector<Token> >(lexer.lex("f(c); { c; { c; } }", "--", ceh)), ceh);
+	test.assert(ceh.counted == 1);
+	deferred.display();
+	test.assert(ceh.counted == 3 && ceh.empty());
+	lazy.onNode = nullptr;
+
+	vector<Token> mtoks = lexer.lex("f(a, {b}); {c}", "--", eh);
+	vector<size_t> match = parser.matchBounds(mtoks, eh);
+	vector<size_t> expectedMatch(mtoks.size(), StructureParser::Unmatched);
+	for (auto &p : vector<pair<size_t, size_t> >({{1, 8}, {5, 7}, {11, 13}}))
+	{
+		expectedMatch[p.first] = p.second;
+		expectedMatch[p.second] = p.first;
+	}
+	test.assert(match == expectedMatch && eh.empty());
+	match = parser.matchBounds(lexer.lex("f(a}; {", "--", eh), eh);
+	test.assert(match[1] == StructureParser::Unmatched && match[3] == StructureParser::Unmatched && !eh.empty());
+	eh = InternalErrorHandler();
+
 	vector<Token> toks2 = {
 		Token("A")
 	};
@@ -35,9 +35,15 @@
  */
 
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <thread>
 #include <MUnit.h>
 
+#include <unistd.h>
+
 #include "../Core/Token.h"
+#include "../Core/LineIndex.h"
 
 using namespace std;
 using namespace mitten;
@@ -51,6 +57,102 @@ int main()
 	test.assert(tmp.file().compare("--") == 0);
 	test.assert(tmp.line() == 5);
 	test.assert(tmp.column() == 2);
+	test.assert(tmp.owned());
+
+	test.assert(sizeof(Token) == 16);
+
+	test.assert(Token().value().empty() && Token().owned() && Token().file().compare("--") == 0);
+	Token global = Token("outer");
+	Token expired;
+	{
+		SourceTable::Scope scope;
+		Token scoped = Token("scoped", "scope.n", 3, 1);
+		test.assert(scoped.value().compare("scoped") == 0 && scoped.file().compare("scope.n") == 0 && scoped.line() == 3);
+		test.assert(Token("outer").value().compare("outer") == 0);
+
+		thread other([&]()
+		{
+			SourceTable::Scope::Join join(&scope);
+			expired = Token(SourceTable::global().add(SourceBuffer::fromString("joined", "scope.n")), 0, 6);
+		});
+		other.join();
+		test.assert(expired.value().compare("joined") == 0);
+	}
+	test.assert(global.value().compare("outer") == 0);
+	test.assert(SourceTable::Scope::current() == NULL);
+	bool expiredThrew = false;
+	try
+	{
+		expired.value();
+	}
+	catch (runtime_error &e)
+	{
+		expiredThrew = true;
+	}
+	test.assert(expiredThrew);
+
+	SourceTable::FileId f = SourceTable::global().add(SourceBuffer::fromString("int\n  hi;", "test.n"));
+	Token view = Token(f, 6, 2, SymbolTag);
+	test.assert(!view.owned());
+	test.assert(view.view() == "hi");
+	test.assert(view.value().compare("hi") == 0);
+	test.assert(view.file().compare("test.n") == 0);
+	test.assert(view.offset() == 6);
+	test.assert(view.line() == 2);
+	test.assert(view.column() == 2);
+	test.assert(view.tag() == SymbolTag);
+	test.assert(!view.filtered());
+
+	SourceTable::FileId removed = SourceTable::global().add(SourceBuffer::fromString("gone", "test.n"));
+	Token orphan = Token(removed, 0, 4);
+	SourceTable::global().remove(removed);
+	SourceTable::global().remove(removed);
+	bool orphaned = false;
+	try
+	{
+		orphan.value();
+	}
+	catch (runtime_error &e)
+	{
+		orphaned = true;
+	}
+	test.assert(orphaned);
+
+	f = SourceTable::global().add(SourceBuffer::fromString("a b", "test.n"), 10, 4);
+	test.assert(Token(f, 2, 1).line() == 10);
+	test.assert(Token(f, 2, 1).column() == 6);
+
+	string body = "ab\ncd\n\nef";
+	LineIndex index(body);
+	int line, column;
+	index.position(4, line, column);
+	test.assert(index.lines() == 4);
+	test.assert(line == 2 && column == 1);
+	test.assert(index.lineText(2) == "cd" && index.lineText(3).empty() && index.lineText(4) == "ef");
+	test.assert(index.lineText(5).empty());
+
+	SourceTable::FileId indexed = SourceTable::global().add(SourceBuffer::fromString(body), 10, 2);
+	StringRef text;
+	test.assert(SourceTable::global().lineText(indexed, 13, text) && text == "ef");
+	test.assert(!SourceTable::global().lineText(indexed, 14, text));
+
+	string path = "TokenTest.tmp";
+	ofstream out(path.c_str());
+	out << "\xEF\xBB\xBFint a;\n";
+	out.close();
+	test.assert(SourceBuffer::fileSize(path) == 10);
+	shared_ptr<const SourceBuffer> mapped = SourceBuffer::fromFile(path);
+	test.assert(mapped->mapped() && mapped->hasBOM() && mapped->view() == "int a;\n");
+	test.assert(SourceBuffer::fromString("\xEF\xBB\xBFx")->size() == 4);
+
+	int fds[2];
+	test.assert(pipe(fds) == 0 && write(fds[1], "\xEF\xBB\xBFpiped", 8) == 8);
+	close(fds[1]);
+	shared_ptr<const SourceBuffer> piped = SourceBuffer::fromDescriptor(fds[0]);
+	close(fds[0]);
+	test.assert(!piped->mapped() && piped->hasBOM() && piped->view() == "piped");
+	remove(path.c_str());
+	test.assert(SourceBuffer::fileSize(path) == -1);
 
 	return (int)(test.write());
 }
\ No newline at end of file
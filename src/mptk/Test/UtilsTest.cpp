@@ -35,6 +35,9 @@
  */
 
 #include <iostream>
+#include <algorithm>
+#include <stdlib.h>
+#include <unistd.h>
 #include <MUnit.h>
 
 #include "../Core/Utils.h"
@@ -50,5 +53,66 @@ int main()
 	string withoutEscapes = "hi\n\x0A\033[0;31mhi\033[0;0m\\ \n";
 	test.assert(evaluateEscapeCodes(withEscapes).compare(withoutEscapes) == 0);
 
+	string haystack;
+	for (int i = 0; i < 300; i++)
+		haystack += "ab*/"[(i*7+i/5)%4];
+	haystack += "*/";
+
+	bool found = true;
+	const char *patterns[] = {"*/", "*", "b*/a", "\"\"\"", "/*/", "ab*/ab*/ab*/ab*/ab*/ab*/ab*/ab*/ab"};
+	for (auto p : patterns)
+	{
+		for (size_t from = 0; from < haystack.size(); from += 3)
+		{
+			size_t n = strlen(p);
+			const char *r = findBytes(haystack.data()+from, haystack.data()+haystack.size(), p, n);
+			size_t expected = haystack.find(p, from);
+			if ((expected == string::npos) != (r == NULL))
+				found = false;
+			else if (r != NULL && (size_t)(r-haystack.data()) != expected)
+				found = false;
+		}
+	}
+	test.assert(found);
+	test.assert(findBytes(haystack.data(), haystack.data()+1, "ab", 2) == NULL);
+
+	bool counted = true;
+	for (size_t from = 0; from < 40; from++)
+	{
+		if (countBytes(haystack.data()+from, haystack.data()+haystack.size(), '*') != (size_t)count(haystack.begin()+from, haystack.end(), '*'))
+			counted = false;
+	}
+	test.assert(counted);
+
+	// Sets with more than eight distinct low-nibble patterns are only approximated by the nibble tables.
+	for (int size : {3, 40})
+	{
+		ByteSet set;
+		for (int i = 0; i < size; i++)
+			set.insert((unsigned char)(i*37+11));
+
+		string text;
+		for (int i = 0; i < 300; i++)
+			text += (char)((i*7) % 256);
+		bool found = true;
+		for (size_t from = 0; from < text.size(); from += 13)
+		{
+			size_t expected = from;
+			while (expected < text.size() && !set.contains((unsigned char)text[expected]))
+				expected++;
+			if (set.find(text.data()+from, text.data()+text.size()) != text.data()+expected)
+				found = false;
+		}
+		test.assert(found);
+	}
+
+	char path[] = "/tmp/UtilsTestXXXXXX";
+	int fd = mkstemp(path);
+	string contents = "\xEF\xBB\xBFhello\n";
+	test.assert(fd >= 0 && write(fd, contents.data(), contents.size()) == (ssize_t)contents.size());
+	close(fd);
+	test.assert(readFile8(path) == contents);
+	unlink(path);
+
 	return (int)(test.write());
 }
\ No newline at end of file